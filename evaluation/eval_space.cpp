@@ -3,6 +3,7 @@
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <malloc.h>
 #include <random>
 #include <sstream>
 #include <unordered_map>
@@ -16,6 +17,7 @@
 #include "funnel.h"
 #include "indexed_partition_hash_with_btree.h"
 #include "perfect_hashing.h"
+#include "static_perfect_hashing.h"
 
 using namespace std;
 
@@ -66,33 +68,109 @@ vector<pair<string, string>> generate_string_dataset(size_t count,
     return dataset;
 }
 
+void report_sweep(size_t keys, size_t mem_kb, ofstream& of) {
+    double bytes_per_key = keys == 0 ? 0.0 : 1024.0 * mem_kb / keys;
+    cout << "[sweep] keys=" << keys << " memory=" << mem_kb
+         << " KB bytes/key=" << bytes_per_key << "\n";
+    of << "[sweep] keys=" << keys << " memory=" << mem_kb
+       << " KB bytes/key=" << bytes_per_key << "\n";
+}
+
+// Sweep checkpoints are after 1/16, 1/8, 1/4 and 1/2 of the keys.
+bool is_sweep_point(size_t inserted, size_t total) {
+    for (size_t shift = 4; shift > 0; --shift)
+        if (inserted == (total >> shift)) return true;
+    return false;
+}
+
+void report_churn(size_t round, size_t mem_kb, ofstream& of) {
+    cout << "[churn] round=" << round << " memory=" << mem_kb << " KB\n";
+    of << "[churn] round=" << round << " memory=" << mem_kb << " KB\n";
+}
+
+// mem_before is sampled before the table is constructed, so memory the
+// table allocates up front is counted too. Each churn round then deletes
+// and reinserts every key, so the live set stays the same size.
 template <typename HashTable, typename DataSet>
-size_t benchmark_space(HashTable& table, DataSet& dataset) {
-    size_t mem_before = get_memory_usage_kb();
-    for (const auto& [k, v] : dataset) table.insert(k, v);
+size_t benchmark_space(HashTable& table, DataSet& dataset, size_t mem_before,
+                       bool sweep, size_t churn, ofstream& of) {
+    size_t inserted = 0;
+    for (const auto& [k, v] : dataset) {
+        table.insert(k, v);
+        if (sweep && is_sweep_point(++inserted, dataset.size()))
+            report_sweep(inserted, get_memory_usage_kb() - mem_before, of);
+    }
+    for (size_t round = 1; round <= churn; ++round) {
+        for (const auto& [k, v] : dataset) table.remove(k);
+        for (const auto& [k, v] : dataset) table.insert(k, v);
+        report_churn(round, get_memory_usage_kb() - mem_before, of);
+    }
     size_t mem_after = get_memory_usage_kb();
+    if (sweep) report_sweep(dataset.size(), mem_after - mem_before, of);
     return mem_after - mem_before;
 }
 
 template <typename HashTable, typename DataSet>
-size_t baseline_space(HashTable& table, DataSet& dataset) {
+size_t baseline_space(HashTable& table, DataSet& dataset, size_t mem_before,
+                      bool sweep, size_t churn, ofstream& of) {
+    size_t inserted = 0;
+    for (const auto& [k, v] : dataset) {
+        table[k] = v;
+        if (sweep && is_sweep_point(++inserted, dataset.size()))
+            report_sweep(inserted, get_memory_usage_kb() - mem_before, of);
+    }
+    for (size_t round = 1; round <= churn; ++round) {
+        for (const auto& [k, v] : dataset) table.erase(k);
+        for (const auto& [k, v] : dataset) table[k] = v;
+        report_churn(round, get_memory_usage_kb() - mem_before, of);
+    }
+    size_t mem_after = get_memory_usage_kb();
+    if (sweep) report_sweep(dataset.size(), mem_after - mem_before, of);
+    return mem_after - mem_before;
+}
+
+template <typename StaticTable, typename DataSet>
+size_t static_space(DataSet& dataset, ofstream& of) {
     size_t mem_before = get_memory_usage_kb();
-    for (const auto& [k, v] : dataset) table[k] = v;
+    StaticTable table(dataset);
     size_t mem_after = get_memory_usage_kb();
+    cout << "MPHF bits/key: " << table.mphfBitsPerKey() << "\n";
+    of << "MPHF bits/key: " << table.mphfBitsPerKey() << "\n";
     return mem_after - mem_before;
 }
 
+template <typename HashTable, typename DataSet>
+size_t filtered_space(HashTable& table, DataSet& dataset, size_t mem_before,
+                      bool sweep, size_t churn, ofstream& of) {
+    size_t mem_used =
+        benchmark_space(table, dataset, mem_before, sweep, churn, of);
+    double filter_bytes = double(table.filterBytes()) / dataset.size();
+    cout << "Filter bytes/key: " << filter_bytes << "\n";
+    of << "Filter bytes/key: " << filter_bytes << "\n";
+    return mem_used;
+}
+
 void print_help() {
     cout << "Usage: ./bin/eval_space [--numKeys <int>] [--load <float>] "
-            "[--hashtable <string>]\n"
+            "[--hashtable <string>] [--churn <int>]\n"
          << "Options:\n"
          << "  --numKeys <int>         Number of keys (default: 1e5)\n"
          << "  --load <float>          Load factor in (0, 100] (default: 1.0)\n"
          << "  --type <string>         number, string (default: number)\n"
          << "  --hashtable <string>    Hash table to test. Options:\n"
          << "                          unordered_map, dynamic, fixed,\n"
-         << "                          perfect, partition, cuckoo, elastic, "
-            "funnel\n"
+         << "                          perfect, static_perfect, partition,\n"
+         << "                          cuckoo, elastic, funnel,\n"
+         << "                          elastic_filtered, funnel_filtered,\n"
+         << "                          elastic_add_level\n"
+         << "  --sweep                 Also report memory after 1/16, 1/8, "
+            "...\n"
+         << "                          of the keys (use --load > 1 to "
+            "overfill)\n"
+         << "  --churn <int>           After loading, delete and reinsert "
+            "every\n"
+         << "                          key this many times, reporting memory "
+            "per round\n"
          << "  --help                  Show this help message\n";
 }
 
@@ -101,6 +179,8 @@ int main(int argc, char* argv[]) {
     double load_factor = 1.0;
     string type = "number";
     string hashtable = "unordered_map";
+    bool sweep = false;
+    size_t churn = 0;
 
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "--help") == 0) {
@@ -118,6 +198,10 @@ int main(int argc, char* argv[]) {
             type = argv[++i];
         } else if (strcmp(argv[i], "--hashtable") == 0 && i + 1 < argc) {
             hashtable = argv[++i];
+        } else if (strcmp(argv[i], "--sweep") == 0) {
+            sweep = true;
+        } else if (strcmp(argv[i], "--churn") == 0 && i + 1 < argc) {
+            churn = static_cast<size_t>(stod(argv[++i]));
         } else {
             cerr << "Unknown or incomplete argument: " << argv[i] << endl;
             return 1;
@@ -146,33 +230,59 @@ int main(int argc, char* argv[]) {
     if (type == "number") {
         vector<pair<uint64_t, uint64_t>> dataset =
             generate_number_dataset(num_keys, key_range);
+        malloc_trim(0);  // return the generator's freed memory to the OS
+        size_t mem_start = get_memory_usage_kb();
 
         if (hashtable == "unordered_map") {
             unordered_map<uint64_t, uint64_t> table;
-            mem_used_kb = baseline_space(table, dataset);
+            mem_used_kb =
+                baseline_space(table, dataset, mem_start, sweep, churn, of);
         } else if (hashtable == "dynamic") {
             DynamicResizeWithLinearProb<uint64_t, uint64_t> table(
                 table_capacity);
-            mem_used_kb = benchmark_space(table, dataset);
+            mem_used_kb =
+                benchmark_space(table, dataset, mem_start, sweep, churn, of);
         } else if (hashtable == "fixed") {
             FixedListChainedHashTable<uint64_t, uint64_t> table(table_capacity);
-            mem_used_kb = benchmark_space(table, dataset);
+            mem_used_kb =
+                benchmark_space(table, dataset, mem_start, sweep, churn, of);
         } else if (hashtable == "perfect") {
             PerfectHash<uint64_t, uint64_t> table(table_capacity);
-            mem_used_kb = benchmark_space(table, dataset);
+            mem_used_kb =
+                benchmark_space(table, dataset, mem_start, sweep, churn, of);
+        } else if (hashtable == "static_perfect") {
+            mem_used_kb = static_space<StaticPerfectHash<uint64_t, uint64_t>>(
+                dataset, of);
         } else if (hashtable == "partition") {
             IndexedPartitionHashWithBTree<uint64_t, uint64_t> table(
                 table_capacity);
-            mem_used_kb = benchmark_space(table, dataset);
+            mem_used_kb =
+                benchmark_space(table, dataset, mem_start, sweep, churn, of);
         } else if (hashtable == "cuckoo") {
             CuckooHash<uint64_t, uint64_t> table(table_capacity);
-            mem_used_kb = benchmark_space(table, dataset);
+            mem_used_kb =
+                benchmark_space(table, dataset, mem_start, sweep, churn, of);
         } else if (hashtable == "elastic") {
             ElasticHash<uint64_t, uint64_t> table(table_capacity);
-            mem_used_kb = benchmark_space(table, dataset);
+            mem_used_kb =
+                benchmark_space(table, dataset, mem_start, sweep, churn, of);
         } else if (hashtable == "funnel") {
             FunnelHash<uint64_t, uint64_t> table(table_capacity);
-            mem_used_kb = benchmark_space(table, dataset);
+            mem_used_kb =
+                benchmark_space(table, dataset, mem_start, sweep, churn, of);
+        } else if (hashtable == "elastic_filtered") {
+            ElasticHash<uint64_t, uint64_t, true> table(table_capacity);
+            mem_used_kb =
+                filtered_space(table, dataset, mem_start, sweep, churn, of);
+        } else if (hashtable == "funnel_filtered") {
+            FunnelHash<uint64_t, uint64_t, true> table(table_capacity);
+            mem_used_kb =
+                filtered_space(table, dataset, mem_start, sweep, churn, of);
+        } else if (hashtable == "elastic_add_level") {
+            using Table = ElasticHash<uint64_t, uint64_t>;
+            Table table(table_capacity, 0.1, Table::Growth::AddLevel);
+            mem_used_kb =
+                benchmark_space(table, dataset, mem_start, sweep, churn, of);
         } else {
             cerr << "Error: unknown hashtable: " << hashtable << endl;
             return 1;
@@ -180,39 +290,68 @@ int main(int argc, char* argv[]) {
     } else {
         vector<pair<string, string>> dataset =
             generate_string_dataset(num_keys, key_range);
+        malloc_trim(0);  // return the generator's freed memory to the OS
+        size_t mem_start = get_memory_usage_kb();
 
         if (hashtable == "unordered_map") {
             unordered_map<string, string> table;
-            mem_used_kb = baseline_space(table, dataset);
+            mem_used_kb =
+                baseline_space(table, dataset, mem_start, sweep, churn, of);
         } else if (hashtable == "dynamic") {
             DynamicResizeWithLinearProb<string, string> table(table_capacity);
-            mem_used_kb = benchmark_space(table, dataset);
+            mem_used_kb =
+                benchmark_space(table, dataset, mem_start, sweep, churn, of);
         } else if (hashtable == "fixed") {
             FixedListChainedHashTable<string, string> table(table_capacity);
-            mem_used_kb = benchmark_space(table, dataset);
+            mem_used_kb =
+                benchmark_space(table, dataset, mem_start, sweep, churn, of);
         } else if (hashtable == "perfect") {
             PerfectHash<string, string> table(table_capacity);
-            mem_used_kb = benchmark_space(table, dataset);
+            mem_used_kb =
+                benchmark_space(table, dataset, mem_start, sweep, churn, of);
+        } else if (hashtable == "static_perfect") {
+            mem_used_kb =
+                static_space<StaticPerfectHash<string, string>>(dataset, of);
         } else if (hashtable == "partition") {
             IndexedPartitionHashWithBTree<string, string> table(table_capacity);
-            mem_used_kb = benchmark_space(table, dataset);
+            mem_used_kb =
+                benchmark_space(table, dataset, mem_start, sweep, churn, of);
         } else if (hashtable == "cuckoo") {
             CuckooHash<string, string> table(table_capacity);
-            mem_used_kb = benchmark_space(table, dataset);
+            mem_used_kb =
+                benchmark_space(table, dataset, mem_start, sweep, churn, of);
         } else if (hashtable == "elastic") {
             ElasticHash<string, string> table(table_capacity);
-            mem_used_kb = benchmark_space(table, dataset);
+            mem_used_kb =
+                benchmark_space(table, dataset, mem_start, sweep, churn, of);
         } else if (hashtable == "funnel") {
             FunnelHash<string, string> table(table_capacity);
-            mem_used_kb = benchmark_space(table, dataset);
+            mem_used_kb =
+                benchmark_space(table, dataset, mem_start, sweep, churn, of);
+        } else if (hashtable == "elastic_filtered") {
+            ElasticHash<string, string, true> table(table_capacity);
+            mem_used_kb =
+                filtered_space(table, dataset, mem_start, sweep, churn, of);
+        } else if (hashtable == "funnel_filtered") {
+            FunnelHash<string, string, true> table(table_capacity);
+            mem_used_kb =
+                filtered_space(table, dataset, mem_start, sweep, churn, of);
+        } else if (hashtable == "elastic_add_level") {
+            using Table = ElasticHash<string, string>;
+            Table table(table_capacity, 0.1, Table::Growth::AddLevel);
+            mem_used_kb =
+                benchmark_space(table, dataset, mem_start, sweep, churn, of);
         } else {
             cerr << "Error: unknown hashtable: " << hashtable << endl;
             return 1;
         }
     }
 
-    cout << "[" << hashtable << "] Memory usage: " << mem_used_kb << " KB\n";
-    of << "[" << hashtable << "] Memory usage: " << mem_used_kb << " KB\n";
+    double bytes_per_key = num_keys == 0 ? 0.0 : 1024.0 * mem_used_kb / num_keys;
+    cout << "[" << hashtable << "] Memory usage: " << mem_used_kb << " KB ("
+         << bytes_per_key << " bytes/key)\n";
+    of << "[" << hashtable << "] Memory usage: " << mem_used_kb << " KB ("
+       << bytes_per_key << " bytes/key)\n";
 
     return 0;
 }
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <random>
 #include <sstream>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -16,6 +17,7 @@
 #include "funnel.h"
 #include "indexed_partition_hash_with_btree.h"
 #include "perfect_hashing.h"
+#include "static_perfect_hashing.h"
 
 using namespace std;
 using namespace std::chrono;
@@ -138,16 +140,20 @@ void run_baseline(HashTable& table, DataSet& dataset, ofstream& of) {
     long long lookup_time = baseline_lookup(table, dataset);
     long long update_time = baseline_update(table, dataset);
     long long delete_time = baseline_delete(table, dataset);
+    // every key is gone now, so a second pass only misses
+    long long delete_miss_time = baseline_delete(table, dataset);
     cout << "[unordered_map]\n"
          << "Insert time: " << insert_time << " ms\n"
          << "Lookup time: " << lookup_time << " ms\n"
          << "Update time: " << update_time << " ms\n"
-         << "Delete time: " << delete_time << " ms\n";
+         << "Delete time: " << delete_time << " ms\n"
+         << "Delete miss time: " << delete_miss_time << " ms\n";
     of << "[unordered_map]\n"
        << "Insert time: " << insert_time << " ms\n"
        << "Lookup time: " << lookup_time << " ms\n"
        << "Update time: " << update_time << " ms\n"
-       << "Delete time: " << delete_time << " ms\n";
+       << "Delete time: " << delete_time << " ms\n"
+       << "Delete miss time: " << delete_miss_time << " ms\n";
 }
 
 template <typename HashTable, typename DataSet>
@@ -157,29 +163,133 @@ void run_benchmark(HashTable& table, DataSet& dataset, ofstream& of,
     long long lookup_time = benchmark_lookup(table, dataset);
     long long update_time = benchmark_update(table, dataset);
     long long delete_time = benchmark_delete(table, dataset);
+    // every key is gone now, so a second pass only misses
+    long long delete_miss_time = benchmark_delete(table, dataset);
     cout << "[" << name << "]\n"
          << "Insert time: " << insert_time << " ms\n"
          << "Lookup time: " << lookup_time << " ms\n"
          << "Update time: " << update_time << " ms\n"
-         << "Delete time: " << delete_time << " ms\n";
+         << "Delete time: " << delete_time << " ms\n"
+         << "Delete miss time: " << delete_miss_time << " ms\n";
     of << "[" << name << "]\n"
        << "Insert time: " << insert_time << " ms\n"
        << "Lookup time: " << lookup_time << " ms\n"
        << "Update time: " << update_time << " ms\n"
-       << "Delete time: " << delete_time << " ms\n";
+       << "Delete time: " << delete_time << " ms\n"
+       << "Delete miss time: " << delete_miss_time << " ms\n";
+}
+
+template <typename BulkTable, typename DataSet>
+void run_bulk_benchmark(DataSet& dataset, ofstream& of, string name) {
+    auto start = high_resolution_clock::now();
+    BulkTable table(dataset);
+    auto end = high_resolution_clock::now();
+    long long build_time = duration_cast<milliseconds>(end - start).count();
+    long long lookup_time = benchmark_lookup(table, dataset);
+    long long update_time = benchmark_update(table, dataset);
+    long long delete_time = benchmark_delete(table, dataset);
+    // every key is gone now, so a second pass only misses
+    long long delete_miss_time = benchmark_delete(table, dataset);
+    cout << "[" << name << "]\n"
+         << "Build time: " << build_time << " ms\n"
+         << "Lookup time: " << lookup_time << " ms\n"
+         << "Update time: " << update_time << " ms\n"
+         << "Delete time: " << delete_time << " ms\n"
+         << "Delete miss time: " << delete_miss_time << " ms\n";
+    of << "[" << name << "]\n"
+       << "Build time: " << build_time << " ms\n"
+       << "Lookup time: " << lookup_time << " ms\n"
+       << "Update time: " << update_time << " ms\n"
+       << "Delete time: " << delete_time << " ms\n"
+       << "Delete miss time: " << delete_miss_time << " ms\n";
+}
+
+template <typename StaticTable, typename DataSet>
+void run_static_benchmark(DataSet& dataset, ofstream& of, string name) {
+    auto start = high_resolution_clock::now();
+    StaticTable table(dataset);
+    auto end = high_resolution_clock::now();
+    long long build_time = duration_cast<milliseconds>(end - start).count();
+    long long lookup_time = benchmark_lookup(table, dataset);
+    cout << "[" << name << "]\n"
+         << "Build time: " << build_time << " ms\n"
+         << "Lookup time: " << lookup_time << " ms\n"
+         << "MPHF bits/key: " << table.mphfBitsPerKey() << "\n";
+    of << "[" << name << "]\n"
+       << "Build time: " << build_time << " ms\n"
+       << "Lookup time: " << lookup_time << " ms\n"
+       << "MPHF bits/key: " << table.mphfBitsPerKey() << "\n";
+}
+
+// Mixed workload of 80% lookups, 10% updates and 10% remove/re-insert
+// pairs, split over 1, 2, 4, ... up to max_threads threads. Each thread
+// works on its own slice of the keys, so results stay checkable.
+template <typename ConcurrentTable, typename DataSet>
+void run_concurrent_benchmark(DataSet& dataset, size_t capacity,
+                              size_t max_threads, size_t ops_per_thread,
+                              ofstream& of, string name) {
+    cout << "[" << name << "]\n";
+    of << "[" << name << "]\n";
+    double base_rate = 0.0;
+    // every thread needs at least one key in its slice
+    max_threads = min(max_threads, dataset.size());
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        ConcurrentTable table(capacity);
+        for (const auto& [k, v] : dataset) table.insert(k, v);
+
+        auto start = high_resolution_clock::now();
+        vector<thread> workers;
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                mt19937_64 rng(t);
+                size_t slice = dataset.size() / threads;
+                size_t lo = t * slice;
+                for (size_t i = 0; i < ops_per_thread; ++i) {
+                    const auto& [k, v] = dataset[lo + rng() % slice];
+                    size_t op = rng() % 10;
+                    if (op == 0) {
+                        table.update(k, v);
+                    } else if (op == 1) {
+                        table.remove(k);
+                        table.insert(k, v);
+                    } else {
+                        auto val = table.lookup(k);
+                        assert(val.has_value() && val.value() == v);
+                    }
+                }
+            });
+        }
+        for (auto& w : workers) w.join();
+        auto end = high_resolution_clock::now();
+
+        double ms = duration_cast<microseconds>(end - start).count() / 1000.0;
+        double rate = threads * ops_per_thread / ms / 1000.0;
+        if (threads == 1) base_rate = rate;
+        cout << "Threads: " << threads << " time: " << ms
+             << " ms throughput: " << rate
+             << " Mops/s speedup: " << rate / base_rate << "\n";
+        of << "Threads: " << threads << " time: " << ms
+           << " ms throughput: " << rate
+           << " Mops/s speedup: " << rate / base_rate << "\n";
+    }
 }
 
 void print_help() {
     cout << "Usage: ./bin/eval_time [--numKeys <int>] [--load <float>] "
-            "[--hashtable <string>]\n"
+            "[--hashtable <string>] [--threads <int>]\n"
          << "Options:\n"
          << "  --numKeys <int>         Number of keys (default: 1e5)\n"
          << "  --load <float>          Load factor in (0, 100] (default: 1.0)\n"
          << "  --type <string>         number, string (default: number)\n"
          << "  --hashtable <string>    Hash table to test. Options:\n"
          << "                          unordered_map, dynamic, fixed,\n"
-         << "                          perfect, partition, cuckoo, elastic, "
-            "funnel\n"
+         << "                          perfect, perfect_bulk, static_perfect,\n"
+         << "                          partition, partition_concurrent,\n"
+         << "                          cuckoo, elastic, funnel,\n"
+         << "                          elastic_filtered, funnel_filtered,\n"
+         << "                          elastic_add_level\n"
+         << "  --threads <int>         Max threads for partition_concurrent\n"
+         << "                          (default: hardware threads)\n"
          << "  --help                  Show this help message\n";
 }
 
@@ -188,6 +298,7 @@ int main(int argc, char* argv[]) {
     double load_factor = 1.0;
     string type = "number";
     string hashtable = "unordered_map";
+    size_t max_threads = max(1u, thread::hardware_concurrency());
 
     for (int i = 1; i < argc; ++i) {
         if (strcmp(argv[i], "--help") == 0) {
@@ -205,6 +316,8 @@ int main(int argc, char* argv[]) {
             type = argv[++i];
         } else if (strcmp(argv[i], "--hashtable") == 0 && i + 1 < argc) {
             hashtable = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            max_threads = max(1, stoi(argv[++i]));
         } else {
             cerr << "Unknown or incomplete argument: " << argv[i] << endl;
             return 1;
@@ -245,10 +358,21 @@ int main(int argc, char* argv[]) {
         } else if (hashtable == "perfect") {
             PerfectHash<uint64_t, uint64_t> table(table_capacity);
             run_benchmark(table, dataset, of, "PerfectHash");
+        } else if (hashtable == "perfect_bulk") {
+            run_bulk_benchmark<PerfectHash<uint64_t, uint64_t>>(dataset, of,
+                                                        "PerfectHash (bulk)");
+        } else if (hashtable == "static_perfect") {
+            run_static_benchmark<StaticPerfectHash<uint64_t, uint64_t>>(
+                dataset, of, "StaticPerfectHash");
         } else if (hashtable == "partition") {
             IndexedPartitionHashWithBTree<uint64_t, uint64_t> table(
                 table_capacity);
             run_benchmark(table, dataset, of, "IndexedPartitionHashWithBTree");
+        } else if (hashtable == "partition_concurrent") {
+            run_concurrent_benchmark<
+                IndexedPartitionHashWithBTree<uint64_t, uint64_t, true>>(
+                dataset, table_capacity, max_threads, num_keys, of,
+                "IndexedPartitionHashWithBTree (concurrent)");
         } else if (hashtable == "cuckoo") {
             CuckooHash<uint64_t, uint64_t> table(table_capacity);
             run_benchmark(table, dataset, of, "CuckooHash");
@@ -258,6 +382,16 @@ int main(int argc, char* argv[]) {
         } else if (hashtable == "funnel") {
             FunnelHash<uint64_t, uint64_t> table(table_capacity);
             run_benchmark(table, dataset, of, "FunnelHash");
+        } else if (hashtable == "elastic_filtered") {
+            ElasticHash<uint64_t, uint64_t, true> table(table_capacity);
+            run_benchmark(table, dataset, of, "ElasticHash (filtered)");
+        } else if (hashtable == "funnel_filtered") {
+            FunnelHash<uint64_t, uint64_t, true> table(table_capacity);
+            run_benchmark(table, dataset, of, "FunnelHash (filtered)");
+        } else if (hashtable == "elastic_add_level") {
+            using Table = ElasticHash<uint64_t, uint64_t>;
+            Table table(table_capacity, 0.1, Table::Growth::AddLevel);
+            run_benchmark(table, dataset, of, "ElasticHash (add-level growth)");
         } else {
             cerr << "Error: unknown hashtable: " << hashtable << endl;
             return 1;
@@ -277,9 +411,20 @@ int main(int argc, char* argv[]) {
         } else if (hashtable == "perfect") {
             PerfectHash<string, string> table(table_capacity);
             run_benchmark(table, dataset, of, "PerfectHash");
+        } else if (hashtable == "perfect_bulk") {
+            run_bulk_benchmark<PerfectHash<string, string>>(dataset, of,
+                                                        "PerfectHash (bulk)");
+        } else if (hashtable == "static_perfect") {
+            run_static_benchmark<StaticPerfectHash<string, string>>(
+                dataset, of, "StaticPerfectHash");
         } else if (hashtable == "partition") {
             IndexedPartitionHashWithBTree<string, string> table(table_capacity);
             run_benchmark(table, dataset, of, "IndexedPartitionHashWithBTree");
+        } else if (hashtable == "partition_concurrent") {
+            run_concurrent_benchmark<
+                IndexedPartitionHashWithBTree<string, string, true>>(
+                dataset, table_capacity, max_threads, num_keys, of,
+                "IndexedPartitionHashWithBTree (concurrent)");
         } else if (hashtable == "cuckoo") {
             CuckooHash<string, string> table(table_capacity);
             run_benchmark(table, dataset, of, "CuckooHash");
@@ -289,6 +434,16 @@ int main(int argc, char* argv[]) {
         } else if (hashtable == "funnel") {
             FunnelHash<string, string> table(table_capacity);
             run_benchmark(table, dataset, of, "FunnelHash");
+        } else if (hashtable == "elastic_filtered") {
+            ElasticHash<string, string, true> table(table_capacity);
+            run_benchmark(table, dataset, of, "ElasticHash (filtered)");
+        } else if (hashtable == "funnel_filtered") {
+            FunnelHash<string, string, true> table(table_capacity);
+            run_benchmark(table, dataset, of, "FunnelHash (filtered)");
+        } else if (hashtable == "elastic_add_level") {
+            using Table = ElasticHash<string, string>;
+            Table table(table_capacity, 0.1, Table::Growth::AddLevel);
+            run_benchmark(table, dataset, of, "ElasticHash (add-level growth)");
         } else {
             cerr << "Error: unknown hashtable: " << hashtable << endl;
             return 1;
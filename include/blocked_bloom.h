@@ -0,0 +1,52 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Blocked Bloom filter with one 64-bit word per block.
+ *
+ * A key sets NUM_BITS bits inside a single word picked by its hash, so a
+ * query reads one word. The high bits of the hash pick the word and the
+ * low bits pick the bits, so callers must pass a well-mixed 64-bit hash.
+ *
+ * There is no removal: bits left behind by removed keys only add false
+ * positives until the owner rebuilds the filter with clear() and add().
+ */
+class BlockedBloomFilter {
+   public:
+    static constexpr size_t BITS_PER_KEY = 8;
+
+    BlockedBloomFilter() = default;
+
+    // Sized for up to `keys` keys at BITS_PER_KEY bits each.
+    explicit BlockedBloomFilter(size_t keys)
+        : words_(std::max<size_t>(1, (keys * BITS_PER_KEY + 63) / 64)) {}
+
+    void add(uint64_t h) { words_[block(h)] |= mask(h); }
+
+    bool mayContain(uint64_t h) const {
+        uint64_t m = mask(h);
+        return (words_[block(h)] & m) == m;
+    }
+
+    void clear() { std::fill(words_.begin(), words_.end(), 0); }
+
+    size_t bytes() const { return words_.size() * sizeof(uint64_t); }
+
+   private:
+    static constexpr int NUM_BITS = 4;
+
+    std::vector<uint64_t> words_;
+
+    size_t block(uint64_t h) const {
+        return size_t((unsigned __int128)h * words_.size() >> 64);
+    }
+
+    static uint64_t mask(uint64_t h) {
+        uint64_t m = 0;
+        for (int i = 0; i < NUM_BITS; ++i) m |= 1ULL << ((h >> (6 * i)) & 63);
+        return m;
+    }
+};
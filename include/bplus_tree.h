@@ -0,0 +1,509 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "btree.h"
+
+/**
+ * @brief An ordered map from Key to Value stored as a B+tree.
+ *
+ * Unlike BTree, values live only in the leaves. Inner nodes hold separator
+ * keys and child pointers, so more of them fit in cache, and the leaves are
+ * chained left to right so ordered scans walk them sequentially. Every node
+ * is aligned to a cache line and allocated from a per-tree NodePool.
+ *
+ * Separator keys[i] of an inner node is no greater than every key under
+ * children[i + 1] and greater than every key under children[0..i]. Removals
+ * may leave a separator that no longer appears in any leaf, which keeps
+ * routing correct.
+ *
+ * @tparam Order Maximum number of children of an inner node and of entries
+ *         in a leaf, must be even. Defaults as for BTree.
+ * @tparam Compare Strict weak ordering on Key.
+ */
+template <typename Key, typename Value, int Order = btreeDefaultOrder<Key>(),
+          typename Compare = std::less<Key>>
+class BPlusTree {
+    static_assert(Order >= 4 && Order % 2 == 0,
+                  "BPlusTree order must be even and at least 4");
+
+    struct Node {
+        int n = 0;  // keys in an inner node, entries in a leaf
+        bool leaf;
+        explicit Node(bool isLeaf) : leaf(isLeaf) {}
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Inner : Node {
+        Key keys[Order - 1];
+        Node* children[Order];
+        Inner() : Node(false) {}
+    };
+
+    struct alignas(CACHE_LINE_SIZE) Leaf : Node {
+        Key keys[Order];
+        Value values[Order];
+        Leaf* next = nullptr;  // right neighbour, nullptr for the last leaf
+        Leaf() : Node(true) {}
+    };
+
+    // Fewest entries a non-root leaf, or keys a non-root inner node, holds.
+    static constexpr int MIN_LEAF = Order / 2;
+    static constexpr int MIN_INNER = Order / 2 - 1;
+
+   public:
+    /**
+     * @brief Forward iterator over the entries in key order.
+     */
+    class const_iterator {
+       public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<const Key&, const Value&>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        const_iterator() = default;
+
+        reference operator*() const {
+            return {leaf_->keys[i_], leaf_->values[i_]};
+        }
+        const Key& key() const { return leaf_->keys[i_]; }
+        const Value& value() const { return leaf_->values[i_]; }
+
+        const_iterator& operator++() {
+            if (++i_ == leaf_->n) {
+                leaf_ = leaf_->next;
+                i_ = 0;
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const const_iterator& o) const {
+            return leaf_ == o.leaf_ && i_ == o.i_;
+        }
+        bool operator!=(const const_iterator& o) const { return !(*this == o); }
+
+       private:
+        friend class BPlusTree;
+
+        const_iterator(const Leaf* leaf, int i) : leaf_(leaf), i_(i) {
+            if (leaf_ != nullptr && i_ == leaf_->n) {
+                leaf_ = leaf_->next;
+                i_ = 0;
+            }
+        }
+
+        const Leaf* leaf_ = nullptr;
+        int i_ = 0;
+    };
+
+    BPlusTree(const Compare& compare = Compare()) : comp(compare) {}
+
+    BPlusTree(const BPlusTree&) = delete;
+    BPlusTree& operator=(const BPlusTree&) = delete;
+
+    BPlusTree(BPlusTree&& other) noexcept
+        : root(std::exchange(other.root, nullptr)),
+          count(std::exchange(other.count, 0)),
+          comp(std::move(other.comp)),
+          inners(std::move(other.inners)),
+          leaves(std::move(other.leaves)) {}
+
+    BPlusTree& operator=(BPlusTree&& other) noexcept {
+        if (this != &other) {
+            clear();
+            root = std::exchange(other.root, nullptr);
+            count = std::exchange(other.count, 0);
+            comp = std::move(other.comp);
+            inners = std::move(other.inners);
+            leaves = std::move(other.leaves);
+        }
+        return *this;
+    }
+
+    ~BPlusTree() { clear(); }
+
+    /**
+     * @brief Inserts a key, replacing the value of an existing equal key.
+     */
+    void insert(const Key& k, const Value& v) {
+        if (root == nullptr) root = leaves.create();
+
+        Key sep;
+        bool inserted = false;
+        Node* right = insert(root, k, v, sep, inserted);
+        if (right != nullptr) {
+            Inner* s = inners.create();
+            s->keys[0] = std::move(sep);
+            s->children[0] = root;
+            s->children[1] = right;
+            s->n = 1;
+            root = s;
+        }
+        if (inserted) ++count;
+    }
+
+    /**
+     * @brief Removes a key.
+     * @return false if the key was absent.
+     */
+    bool remove(const Key& k) {
+        if (root == nullptr || !remove(root, k)) return false;
+        --count;
+
+        if (root->n == 0) {
+            Node* old = root;
+            if (root->leaf) {
+                root = nullptr;
+                leaves.destroy(static_cast<Leaf*>(old));
+            } else {
+                root = static_cast<Inner*>(old)->children[0];
+                inners.destroy(static_cast<Inner*>(old));
+            }
+        }
+        return true;
+    }
+
+    std::optional<Value> search(const Key& k) const {
+        const_iterator it = find(k);
+        if (it == end()) return std::nullopt;
+        return it.value();
+    }
+
+    bool contains(const Key& k) const { return find(k) != end(); }
+
+    /**
+     * @brief Returns an iterator to k, or end() if it is absent.
+     */
+    const_iterator find(const Key& k) const {
+        const_iterator it = lower_bound(k);
+        if (it != end() && !comp(k, it.key())) return it;
+        return end();
+    }
+
+    /**
+     * @brief Returns an iterator to the first key not less than k.
+     */
+    const_iterator lower_bound(const Key& k) const {
+        if (root == nullptr) return end();
+        const Leaf* leaf = findLeaf(k);
+        int i = nodeSearch(leaf->keys, leaf->n, k, comp);
+        return const_iterator(leaf, i);
+    }
+
+    /**
+     * @brief Returns an iterator to the first key greater than k.
+     */
+    const_iterator upper_bound(const Key& k) const {
+        if (root == nullptr) return end();
+        const Leaf* leaf = findLeaf(k);
+        int i = nodeSearch<true>(leaf->keys, leaf->n, k, comp);
+        return const_iterator(leaf, i);
+    }
+
+    /**
+     * @brief Calls visit(key, value) for every key in [lo, hi), in order.
+     * @return The number of entries visited.
+     */
+    template <typename Visit>
+    size_t scan(const Key& lo, const Key& hi, Visit visit) const {
+        size_t visited = 0;
+        for (const_iterator it = lower_bound(lo);
+             it != end() && comp(it.key(), hi); ++it, ++visited)
+            visit(it.key(), it.value());
+        return visited;
+    }
+
+    const_iterator begin() const {
+        if (root == nullptr) return end();
+        const Node* x = root;
+        while (!x->leaf) x = static_cast<const Inner*>(x)->children[0];
+        return const_iterator(static_cast<const Leaf*>(x), 0);
+    }
+
+    const_iterator end() const { return const_iterator(); }
+
+    /**
+     * @brief Drops every key. Nodes are freed in bulk; for trivially
+     *        destructible keys and values this does not walk the tree.
+     */
+    void clear() {
+        if constexpr (!std::is_trivially_destructible_v<Leaf> ||
+                      !std::is_trivially_destructible_v<Inner>) {
+            if (root != nullptr) destroySubtree(root);
+        }
+        inners.release();
+        leaves.release();
+        root = nullptr;
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+
+    // Bytes held by the node pools
+    size_t bytes() const { return inners.bytes() + leaves.bytes(); }
+
+   private:
+    Node* root = nullptr;
+    size_t count = 0;
+    Compare comp;
+    NodePool<Inner> inners;
+    NodePool<Leaf> leaves;
+
+    // Index of the child of x whose subtree may hold k.
+    int childIndex(const Inner* x, const Key& k) const {
+        return nodeSearch<true>(x->keys, x->n, k, comp);
+    }
+
+    const Leaf* findLeaf(const Key& k) const {
+        const Node* x = root;
+        while (!x->leaf) {
+            const Inner* in = static_cast<const Inner*>(x);
+            x = in->children[childIndex(in, k)];
+        }
+        return static_cast<const Leaf*>(x);
+    }
+
+    // Inserts into the subtree at x. If x had to split, returns its new
+    // right sibling and stores the separator between them in sep.
+    Node* insert(Node* x, const Key& k, const Value& v, Key& sep,
+                 bool& inserted) {
+        if (x->leaf) return insertIntoLeaf(static_cast<Leaf*>(x), k, v, sep,
+                                           inserted);
+
+        Inner* in = static_cast<Inner*>(x);
+        int i = childIndex(in, k);
+        Key childSep;
+        Node* right = insert(in->children[i], k, v, childSep, inserted);
+        if (right == nullptr) return nullptr;
+        return insertIntoInner(in, i, childSep, right, sep);
+    }
+
+    Node* insertIntoLeaf(Leaf* leaf, const Key& k, const Value& v, Key& sep,
+                         bool& inserted) {
+        int pos = nodeSearch(leaf->keys, leaf->n, k, comp);
+        if (pos < leaf->n && !comp(k, leaf->keys[pos])) {
+            leaf->values[pos] = v;
+            return nullptr;
+        }
+        inserted = true;
+
+        if (leaf->n < Order) {
+            insertAt(leaf, pos, k, v);
+            return nullptr;
+        }
+
+        // Split the full leaf in half, then insert into the proper half.
+        Leaf* right = leaves.create();
+        for (int j = 0; j < Order / 2; j++) {
+            right->keys[j] = std::move(leaf->keys[j + Order / 2]);
+            right->values[j] = std::move(leaf->values[j + Order / 2]);
+        }
+        right->n = Order / 2;
+        leaf->n = Order / 2;
+        right->next = leaf->next;
+        leaf->next = right;
+
+        if (pos <= Order / 2)
+            insertAt(leaf, pos, k, v);
+        else
+            insertAt(right, pos - Order / 2, k, v);
+        sep = right->keys[0];
+        return right;
+    }
+
+    static void insertAt(Leaf* leaf, int pos, const Key& k, const Value& v) {
+        for (int j = leaf->n; j > pos; j--) {
+            leaf->keys[j] = std::move(leaf->keys[j - 1]);
+            leaf->values[j] = std::move(leaf->values[j - 1]);
+        }
+        leaf->keys[pos] = k;
+        leaf->values[pos] = v;
+        leaf->n++;
+    }
+
+    // Adds separator k and the child to its right at key position pos.
+    Node* insertIntoInner(Inner* in, int pos, Key& k, Node* child,
+                          Key& sep) {
+        if (in->n < Order - 1) {
+            insertAt(in, pos, k, child);
+            return nullptr;
+        }
+
+        // Split around the middle key, which moves up, then insert.
+        constexpr int mid = Order / 2 - 1;
+        Inner* right = inners.create();
+        for (int j = 0; j < Order - 2 - mid; j++)
+            right->keys[j] = std::move(in->keys[j + mid + 1]);
+        for (int j = 0; j < Order - 1 - mid; j++)
+            right->children[j] = in->children[j + mid + 1];
+        right->n = Order - 2 - mid;
+        in->n = mid;
+        Key up = std::move(in->keys[mid]);
+
+        if (pos <= mid)
+            insertAt(in, pos, k, child);
+        else
+            insertAt(right, pos - mid - 1, k, child);
+        sep = std::move(up);
+        return right;
+    }
+
+    static void insertAt(Inner* in, int pos, Key& k, Node* child) {
+        for (int j = in->n; j > pos; j--) {
+            in->keys[j] = std::move(in->keys[j - 1]);
+            in->children[j + 1] = in->children[j];
+        }
+        in->keys[pos] = std::move(k);
+        in->children[pos + 1] = child;
+        in->n++;
+    }
+
+    // Removes k from the subtree at x, rebalancing underfull children on
+    // the way back up.
+    bool remove(Node* x, const Key& k) {
+        if (x->leaf) {
+            Leaf* leaf = static_cast<Leaf*>(x);
+            int pos = nodeSearch(leaf->keys, leaf->n, k, comp);
+            if (pos == leaf->n || comp(k, leaf->keys[pos])) return false;
+            for (int j = pos + 1; j < leaf->n; j++) {
+                leaf->keys[j - 1] = std::move(leaf->keys[j]);
+                leaf->values[j - 1] = std::move(leaf->values[j]);
+            }
+            leaf->n--;
+            return true;
+        }
+
+        Inner* in = static_cast<Inner*>(x);
+        int i = childIndex(in, k);
+        if (!remove(in->children[i], k)) return false;
+
+        Node* child = in->children[i];
+        if (child->n < (child->leaf ? MIN_LEAF : MIN_INNER)) rebalance(in, i);
+        return true;
+    }
+
+    // Refills the underfull child i of in from a sibling, or merges it
+    // with one.
+    void rebalance(Inner* in, int i) {
+        int min = in->children[i]->leaf ? MIN_LEAF : MIN_INNER;
+        if (i > 0 && in->children[i - 1]->n > min)
+            borrowFromPrev(in, i);
+        else if (i < in->n && in->children[i + 1]->n > min)
+            borrowFromNext(in, i);
+        else if (i > 0)
+            merge(in, i - 1);
+        else
+            merge(in, i);
+    }
+
+    void borrowFromPrev(Inner* in, int i) {
+        if (in->children[i]->leaf) {
+            Leaf* child = static_cast<Leaf*>(in->children[i]);
+            Leaf* sibling = static_cast<Leaf*>(in->children[i - 1]);
+            for (int j = child->n; j > 0; j--) {
+                child->keys[j] = std::move(child->keys[j - 1]);
+                child->values[j] = std::move(child->values[j - 1]);
+            }
+            child->keys[0] = std::move(sibling->keys[sibling->n - 1]);
+            child->values[0] = std::move(sibling->values[sibling->n - 1]);
+            in->keys[i - 1] = child->keys[0];
+            child->n++;
+            sibling->n--;
+            return;
+        }
+
+        Inner* child = static_cast<Inner*>(in->children[i]);
+        Inner* sibling = static_cast<Inner*>(in->children[i - 1]);
+        for (int j = child->n; j > 0; j--)
+            child->keys[j] = std::move(child->keys[j - 1]);
+        for (int j = child->n + 1; j > 0; j--)
+            child->children[j] = child->children[j - 1];
+        child->keys[0] = std::move(in->keys[i - 1]);
+        child->children[0] = sibling->children[sibling->n];
+        in->keys[i - 1] = std::move(sibling->keys[sibling->n - 1]);
+        child->n++;
+        sibling->n--;
+    }
+
+    void borrowFromNext(Inner* in, int i) {
+        if (in->children[i]->leaf) {
+            Leaf* child = static_cast<Leaf*>(in->children[i]);
+            Leaf* sibling = static_cast<Leaf*>(in->children[i + 1]);
+            child->keys[child->n] = std::move(sibling->keys[0]);
+            child->values[child->n] = std::move(sibling->values[0]);
+            for (int j = 1; j < sibling->n; j++) {
+                sibling->keys[j - 1] = std::move(sibling->keys[j]);
+                sibling->values[j - 1] = std::move(sibling->values[j]);
+            }
+            in->keys[i] = sibling->keys[0];
+            child->n++;
+            sibling->n--;
+            return;
+        }
+
+        Inner* child = static_cast<Inner*>(in->children[i]);
+        Inner* sibling = static_cast<Inner*>(in->children[i + 1]);
+        child->keys[child->n] = std::move(in->keys[i]);
+        child->children[child->n + 1] = sibling->children[0];
+        in->keys[i] = std::move(sibling->keys[0]);
+        for (int j = 1; j < sibling->n; j++)
+            sibling->keys[j - 1] = std::move(sibling->keys[j]);
+        for (int j = 1; j <= sibling->n; j++)
+            sibling->children[j - 1] = sibling->children[j];
+        child->n++;
+        sibling->n--;
+    }
+
+    // Merges child i + 1 of in into child i and drops separator i.
+    void merge(Inner* in, int i) {
+        if (in->children[i]->leaf) {
+            Leaf* child = static_cast<Leaf*>(in->children[i]);
+            Leaf* sibling = static_cast<Leaf*>(in->children[i + 1]);
+            for (int j = 0; j < sibling->n; j++) {
+                child->keys[child->n + j] = std::move(sibling->keys[j]);
+                child->values[child->n + j] = std::move(sibling->values[j]);
+            }
+            child->n += sibling->n;
+            child->next = sibling->next;
+            leaves.destroy(sibling);
+        } else {
+            Inner* child = static_cast<Inner*>(in->children[i]);
+            Inner* sibling = static_cast<Inner*>(in->children[i + 1]);
+            child->keys[child->n] = std::move(in->keys[i]);
+            for (int j = 0; j < sibling->n; j++)
+                child->keys[child->n + 1 + j] = std::move(sibling->keys[j]);
+            for (int j = 0; j <= sibling->n; j++)
+                child->children[child->n + 1 + j] = sibling->children[j];
+            child->n += sibling->n + 1;
+            inners.destroy(sibling);
+        }
+
+        for (int j = i + 1; j < in->n; j++) {
+            in->keys[j - 1] = std::move(in->keys[j]);
+            in->children[j] = in->children[j + 1];
+        }
+        in->n--;
+    }
+
+    void destroySubtree(Node* x) {
+        if (x->leaf) {
+            static_cast<Leaf*>(x)->~Leaf();
+            return;
+        }
+        Inner* in = static_cast<Inner*>(x);
+        for (int i = 0; i <= in->n; i++) destroySubtree(in->children[i]);
+        in->~Inner();
+    }
+};
@@ -1,125 +1,446 @@
 // C++ Program to Implement B-Tree
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 using namespace std;
 
-const int ORDER = 6;
+// Size of a cache line on the targets we care about.
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+#ifdef __SSE4_2__
+constexpr bool SSE42_AVAILABLE = true;
+#else
+constexpr bool SSE42_AVAILABLE = false;
+#endif
+
+// Whether this build has a vector compare for keys of the given size:
+// AVX2 for every width, SSE2 alone for up to 32 bits, and SSE2 with SSE4.2
+// for 64 bits.
+constexpr bool btreeSimdCompiled(size_t keySize) {
+#if defined(__AVX2__)
+    return true;
+#elif defined(__SSE2__)
+    return keySize < 8 || SSE42_AVAILABLE;
+#else
+    return false;
+#endif
+}
+
+// True when searches over Key compare a whole node with SIMD: integer keys
+// ordered by std::less, with a vector compare of their width compiled in.
+template <typename Key, typename Compare>
+constexpr bool btreeSimdSearch =
+    std::is_integral_v<Key> && !std::is_same_v<Key, bool> &&
+    std::is_same_v<Compare, std::less<Key>> &&
+    btreeSimdCompiled(sizeof(Key));
+
+// Default order: as many keys as fit in two cache lines, or four for keys
+// searched with SIMD, where a wider node costs only a few more compares.
+// Rounded down to an even order (splits and merges assume Order / 2 keys
+// per half) and at least 4.
+template <typename Key, typename Compare = std::less<Key>>
+constexpr int btreeDefaultOrder() {
+    constexpr size_t lines = btreeSimdSearch<Key, Compare> ? 4 : 2;
+    constexpr size_t fit = lines * CACHE_LINE_SIZE / sizeof(Key);
+    return fit < 4 ? 4 : static_cast<int>(fit & ~size_t(1));
+}
+
+/**
+ * @brief Position of k among the n sorted keys of a node.
+ *
+ * Returns the number of keys less than k, or, with Upper, not greater than
+ * k. Integer keys are compared a vector at a time (AVX2, or SSE2 with
+ * SSE4.2 for 64-bit keys) and the matching lanes counted with popcount;
+ * the scan stops at the first vector holding a key past k. Other keys, and
+ * the tail of a node, are scanned one at a time.
+ */
+template <bool Upper = false, typename Key, typename Compare>
+int nodeSearch(const Key* keys, int n, const Key& k, const Compare& comp) {
+    int i = 0;
+    if constexpr (btreeSimdSearch<Key, Compare>) {
+        // Signed compares order unsigned keys once their top bits flip.
+        using S = std::make_signed_t<Key>;
+        constexpr S bias = std::is_signed_v<Key>
+                               ? S(0)
+                               : std::numeric_limits<S>::min();
+        constexpr size_t W = sizeof(Key);
+        const S needle = static_cast<S>(static_cast<S>(k) ^ bias);
+#if defined(__AVX2__)
+        auto set1 = [](S x) {
+            if constexpr (W == 1) return _mm256_set1_epi8(x);
+            else if constexpr (W == 2) return _mm256_set1_epi16(x);
+            else if constexpr (W == 4) return _mm256_set1_epi32(x);
+            else return _mm256_set1_epi64x(x);
+        };
+        auto gt = [](__m256i a, __m256i b) {
+            if constexpr (W == 1) return _mm256_cmpgt_epi8(a, b);
+            else if constexpr (W == 2) return _mm256_cmpgt_epi16(a, b);
+            else if constexpr (W == 4) return _mm256_cmpgt_epi32(a, b);
+            else return _mm256_cmpgt_epi64(a, b);
+        };
+        constexpr int LANES = 32 / W;
+        const __m256i vbias = set1(bias), vk = set1(needle);
+        for (; i + LANES <= n; i += LANES) {
+            __m256i v = _mm256_xor_si256(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)),
+                vbias);
+            // Lanes still at or before k: v < k, or v <= k for Upper.
+            __m256i before = Upper ? _mm256_xor_si256(gt(v, vk), set1(-1))
+                                   : gt(vk, v);
+            uint32_t mask = uint32_t(_mm256_movemask_epi8(before));
+            if (mask != 0xFFFFFFFFu) return i + __builtin_popcount(mask) / W;
+        }
+#elif defined(__SSE2__)
+        if constexpr (W < 8 || SSE42_AVAILABLE) {
+            auto set1 = [](S x) {
+                if constexpr (W == 1) return _mm_set1_epi8(x);
+                else if constexpr (W == 2) return _mm_set1_epi16(x);
+                else if constexpr (W == 4) return _mm_set1_epi32(x);
+                else return _mm_set1_epi64x(x);
+            };
+            auto gt = [](__m128i a, __m128i b) {
+                if constexpr (W == 1) return _mm_cmpgt_epi8(a, b);
+                else if constexpr (W == 2) return _mm_cmpgt_epi16(a, b);
+                else if constexpr (W == 4) return _mm_cmpgt_epi32(a, b);
+#ifdef __SSE4_2__
+                else return _mm_cmpgt_epi64(a, b);
+#else
+                else return a;  // unreachable, 64-bit needs SSE4.2
+#endif
+            };
+            constexpr int LANES = 16 / W;
+            const __m128i vbias = set1(bias), vk = set1(needle);
+            for (; i + LANES <= n; i += LANES) {
+                __m128i v = _mm_xor_si128(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)),
+                    vbias);
+                __m128i before =
+                    Upper ? _mm_xor_si128(gt(v, vk), set1(-1)) : gt(vk, v);
+                uint32_t mask = uint32_t(_mm_movemask_epi8(before));
+                if (mask != 0xFFFFu) return i + __builtin_popcount(mask) / W;
+            }
+        }
+#endif
+        (void)needle;
+    }
+    if constexpr (Upper) {
+        while (i < n && !comp(k, keys[i])) i++;
+    } else {
+        while (i < n && comp(keys[i], k)) i++;
+    }
+    return i;
+}
+
+/**
+ * @brief Chunked pool allocator for fixed-size objects.
+ *
+ * Objects are carved from chunks that double in size up to MAX_CHUNK
+ * objects, so a pool serving a tiny tree costs little more than its nodes.
+ * Destroyed objects go on an intrusive free list and are reused before a
+ * new chunk is allocated. release() frees every chunk at once.
+ */
+template <typename T>
+class NodePool {
+   public:
+    static constexpr size_t MAX_CHUNK = 256;
+
+    NodePool() = default;
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    NodePool(NodePool&& other) noexcept { swap(other); }
+
+    NodePool& operator=(NodePool&& other) noexcept {
+        if (this != &other) {
+            release();
+            swap(other);
+        }
+        return *this;
+    }
+
+    /**
+     * @brief Constructs a T in a free slot.
+     */
+    template <typename... Args>
+    T* create(Args&&... args) {
+        Slot* slot = free_;
+        if (slot != nullptr) {
+            free_ = slot->next;
+        } else {
+            if (used_ == chunk_size_) {
+                chunk_size_ =
+                    std::min(MAX_CHUNK, std::max<size_t>(1, 2 * chunk_size_));
+                chunks_.emplace_back(new Slot[chunk_size_]);
+                used_ = 0;
+            }
+            slot = &chunks_.back()[used_++];
+        }
+        return new (slot->storage) T(std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Destroys an object and returns its slot to the pool.
+     */
+    void destroy(T* p) {
+        p->~T();
+        Slot* slot = reinterpret_cast<Slot*>(p);
+        slot->next = free_;
+        free_ = slot;
+    }
+
+    /**
+     * @brief Frees every chunk at once without running destructors. Objects
+     *        still alive must already have been destroyed by the caller
+     *        unless T is trivially destructible.
+     */
+    void release() {
+        chunks_.clear();
+        chunk_size_ = used_ = 0;
+        free_ = nullptr;
+    }
+
+    /**
+     * @brief Returns the number of bytes held in chunks.
+     */
+    size_t bytes() const {
+        size_t total = 0, size = 0;
+        for (size_t i = 0; i < chunks_.size(); ++i) {
+            size = std::min(MAX_CHUNK, std::max<size_t>(1, 2 * size));
+            total += size * sizeof(Slot);
+        }
+        return total;
+    }
+
+   private:
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> chunks_;
+    size_t chunk_size_ = 0;  // slots in the newest chunk
+    size_t used_ = 0;        // slots handed out from the newest chunk
+    Slot* free_ = nullptr;
+
+    void swap(NodePool& other) {
+        chunks_.swap(other.chunks_);
+        std::swap(chunk_size_, other.chunk_size_);
+        std::swap(used_, other.used_);
+        std::swap(free_, other.free_);
+    }
+};
 
 // class for the node present in a B-Tree
+template <typename Key, typename Value, int Order>
 class BTreeNode {
    public:
-    // Array of keys
-    pair<uint8_t, uint8_t> keys[ORDER - 1];
-    // Array of child pointers
-    BTreeNode* children[ORDER];
-    // Current number of keys
+    // Current number of keys, first so it shares a cache line with the
+    // first keys
     int n;
     // True if leaf node, false otherwise
     bool leaf;
+    // Array of keys, kept apart from the values so searches scan them
+    // contiguously
+    Key keys[Order - 1];
+    // Values, values[i] belongs to keys[i]
+    Value values[Order - 1];
+    // Array of child pointers
+    BTreeNode* children[Order];
 
     BTreeNode(bool isLeaf = true) : n(0), leaf(isLeaf) {
-        for (int i = 0; i < ORDER; i++) children[i] = nullptr;
+        for (int i = 0; i < Order; i++) children[i] = nullptr;
     }
 };
 
-// class for B-Tree
+/**
+ * @brief An ordered map from Key to Value stored as a B-tree.
+ *
+ * @tparam Order Maximum number of children per node, must be even. Defaults
+ *         to the number of keys that fit in two cache lines, or four for
+ *         integer keys searched with SIMD (see btreeDefaultOrder).
+ * @tparam Compare Strict weak ordering on Key; keys a and b are equal when
+ *         neither compares less than the other.
+ */
+template <typename Key, typename Value, int Order = btreeDefaultOrder<Key>(),
+          typename Compare = std::less<Key>>
 class BTree {
+    static_assert(Order >= 4 && Order % 2 == 0,
+                  "BTree order must be even and at least 4");
+
+   public:
+    using Node = BTreeNode<Key, Value, Order>;
+
    private:
-    BTreeNode* root;  // Pointer to root node
+    Node* root = nullptr;  // Pointer to root node
+    size_t count = 0;
+    Compare comp;
+    NodePool<Node> pool;  // Owns every node of the tree
 
     // Function to split a full child node
-    void splitChild(BTreeNode* x, int i) {
-        BTreeNode* y = x->children[i];
-        BTreeNode* z = new BTreeNode(y->leaf);
-        z->n = ORDER / 2 - 1;
-
-        for (int j = 0; j < ORDER / 2 - 1; j++)
-            z->keys[j] = y->keys[j + ORDER / 2];
+    void splitChild(Node* x, int i) {
+        Node* y = x->children[i];
+        Node* z = pool.create(y->leaf);
+        z->n = Order / 2 - 1;
+
+        for (int j = 0; j < Order / 2 - 1; j++) {
+            z->keys[j] = std::move(y->keys[j + Order / 2]);
+            z->values[j] = std::move(y->values[j + Order / 2]);
+        }
 
         if (!y->leaf) {
-            for (int j = 0; j < ORDER / 2; j++)
-                z->children[j] = y->children[j + ORDER / 2];
+            for (int j = 0; j < Order / 2; j++)
+                z->children[j] = y->children[j + Order / 2];
         }
 
-        y->n = ORDER / 2 - 1;
+        y->n = Order / 2 - 1;
 
         for (int j = x->n; j >= i + 1; j--) x->children[j + 1] = x->children[j];
 
         x->children[i + 1] = z;
 
-        for (int j = x->n - 1; j >= i; j--) x->keys[j + 1] = x->keys[j];
+        for (int j = x->n - 1; j >= i; j--) {
+            x->keys[j + 1] = std::move(x->keys[j]);
+            x->values[j + 1] = std::move(x->values[j]);
+        }
 
-        x->keys[i] = y->keys[ORDER / 2 - 1];
+        x->keys[i] = std::move(y->keys[Order / 2 - 1]);
+        x->values[i] = std::move(y->values[Order / 2 - 1]);
         x->n = x->n + 1;
     }
 
-    // Function to insert a key in a non-full node
-    void insertNonFull(BTreeNode* x, pair<uint8_t, uint8_t> k) {
-        int i = x->n - 1;
+    // Deepest tree possible: every node but the root has at least two
+    // children, so 64 levels would hold more than 2^64 keys
+    static constexpr int MAX_HEIGHT = 64;
+
+    // Function to insert a key in a non-full node, walking down and
+    // splitting full children ahead of the descent. Replaces the value of
+    // an equal key instead; returns whether a key was added.
+    bool insertNonFull(Node* x, const Key& k, const Value& v) {
+        while (true) {
+            int i = nodeSearch(x->keys, x->n, k, comp);
 
-        if (x->leaf) {
-            while (i >= 0 && k < x->keys[i]) {
-                x->keys[i + 1] = x->keys[i];
-                i--;
+            if (i < x->n && !comp(k, x->keys[i])) {
+                x->values[i] = v;
+                return false;
             }
 
-            x->keys[i + 1] = k;
-            x->n = x->n + 1;
-        } else {
-            while (i >= 0 && k < x->keys[i]) i--;
+            if (x->leaf) {
+                for (int j = x->n; j > i; j--) {
+                    x->keys[j] = std::move(x->keys[j - 1]);
+                    x->values[j] = std::move(x->values[j - 1]);
+                }
+
+                x->keys[i] = k;
+                x->values[i] = v;
+                x->n = x->n + 1;
+                return true;
+            }
 
-            i++;
-            if (x->children[i]->n == ORDER - 1) {
+            if (x->children[i]->n == Order - 1) {
                 splitChild(x, i);
 
-                if (k > x->keys[i]) i++;
+                if (comp(x->keys[i], k)) {
+                    i++;
+                } else if (!comp(k, x->keys[i])) {
+                    // The key was the median that moved up
+                    x->values[i] = v;
+                    return false;
+                }
             }
-            insertNonFull(x->children[i], k);
+            x = x->children[i];
         }
     }
 
-    // Function to traverse the tree
-    void traverse(BTreeNode* x) {
-        int i;
-        for (i = 0; i < x->n; i++) {
-            if (!x->leaf) traverse(x->children[i]);
-            cout << " (" << x->keys[i].first << ", " << x->keys[i].second
-                 << ")";
-        }
+    // Function to traverse the tree with an explicit stack, visiting the
+    // keys of each node between its children
+    template <typename Visit>
+    void traverse(const Node* x, Visit& visit) const {
+        const Node* path[MAX_HEIGHT];
+        int next[MAX_HEIGHT];  // key to visit once its left child is done
+        int depth = 0;
+
+        auto descendLeft = [&](const Node* y) {
+            while (true) {
+                path[depth] = y;
+                next[depth++] = 0;
+                if (y->leaf) return;
+                y = y->children[0];
+            }
+        };
+        descendLeft(x);
+
+        while (depth > 0) {
+            const Node* y = path[depth - 1];
+            if (y->leaf) {
+                for (int i = 0; i < y->n; i++) visit(y->keys[i], y->values[i]);
+                depth--;
+                continue;
+            }
 
-        if (!x->leaf) traverse(x->children[i]);
+            int i = next[depth - 1];
+            if (i == y->n) {
+                depth--;
+                continue;
+            }
+            visit(y->keys[i], y->values[i]);
+            next[depth - 1] = i + 1;
+            descendLeft(y->children[i + 1]);
+        }
     }
 
     // Function to search a key in the tree
-    BTreeNode* search(BTreeNode* x, pair<uint8_t, uint8_t> k) {
-        int i = 0;
-        while (i < x->n && k > x->keys[i]) i++;
+    Value* search(Node* x, const Key& k) const {
+        while (true) {
+            int i = nodeSearch(x->keys, x->n, k, comp);
 
-        if (i < x->n && k.first == x->keys[i].first) return x;
+            if (i < x->n && !comp(k, x->keys[i])) return &x->values[i];
 
-        if (x->leaf) return nullptr;
+            if (x->leaf) return nullptr;
 
-        return search(x->children[i], k);
+            x = x->children[i];
+        }
     }
 
     // Function to find the predecessor
-    pair<uint8_t, uint8_t> getPredecessor(BTreeNode* node, int idx) {
-        BTreeNode* current = node->children[idx];
+    Node* getPredecessor(Node* node, int idx) {
+        Node* current = node->children[idx];
         while (!current->leaf) current = current->children[current->n];
-        return current->keys[current->n - 1];
+        return current;
     }
 
     // Function to find the successor
-    pair<uint8_t, uint8_t> getSuccessor(BTreeNode* node, int idx) {
-        BTreeNode* current = node->children[idx + 1];
+    Node* getSuccessor(Node* node, int idx) {
+        Node* current = node->children[idx + 1];
         while (!current->leaf) current = current->children[0];
-        return current->keys[0];
+        return current;
     }
 
     // Function to fill child node
-    void fill(BTreeNode* node, int idx) {
-        if (idx != 0 && node->children[idx - 1]->n >= ORDER / 2)
+    void fill(Node* node, int idx) {
+        if (idx != 0 && node->children[idx - 1]->n >= Order / 2)
             borrowFromPrev(node, idx);
-        else if (idx != node->n && node->children[idx + 1]->n >= ORDER / 2)
+        else if (idx != node->n && node->children[idx + 1]->n >= Order / 2)
             borrowFromNext(node, idx);
         else {
             if (idx != node->n)
@@ -130,41 +451,49 @@ class BTree {
     }
 
     // Function to borrow from previous sibling
-    void borrowFromPrev(BTreeNode* node, int idx) {
-        BTreeNode* child = node->children[idx];
-        BTreeNode* sibling = node->children[idx - 1];
+    void borrowFromPrev(Node* node, int idx) {
+        Node* child = node->children[idx];
+        Node* sibling = node->children[idx - 1];
 
-        for (int i = child->n - 1; i >= 0; --i)
-            child->keys[i + 1] = child->keys[i];
+        for (int i = child->n - 1; i >= 0; --i) {
+            child->keys[i + 1] = std::move(child->keys[i]);
+            child->values[i + 1] = std::move(child->values[i]);
+        }
 
         if (!child->leaf) {
             for (int i = child->n; i >= 0; --i)
                 child->children[i + 1] = child->children[i];
         }
 
-        child->keys[0] = node->keys[idx - 1];
+        child->keys[0] = std::move(node->keys[idx - 1]);
+        child->values[0] = std::move(node->values[idx - 1]);
 
         if (!child->leaf) child->children[0] = sibling->children[sibling->n];
 
-        node->keys[idx - 1] = sibling->keys[sibling->n - 1];
+        node->keys[idx - 1] = std::move(sibling->keys[sibling->n - 1]);
+        node->values[idx - 1] = std::move(sibling->values[sibling->n - 1]);
 
         child->n += 1;
         sibling->n -= 1;
     }
 
     // Function to borrow from next sibling
-    void borrowFromNext(BTreeNode* node, int idx) {
-        BTreeNode* child = node->children[idx];
-        BTreeNode* sibling = node->children[idx + 1];
+    void borrowFromNext(Node* node, int idx) {
+        Node* child = node->children[idx];
+        Node* sibling = node->children[idx + 1];
 
-        child->keys[child->n] = node->keys[idx];
+        child->keys[child->n] = std::move(node->keys[idx]);
+        child->values[child->n] = std::move(node->values[idx]);
 
         if (!child->leaf) child->children[child->n + 1] = sibling->children[0];
 
-        node->keys[idx] = sibling->keys[0];
+        node->keys[idx] = std::move(sibling->keys[0]);
+        node->values[idx] = std::move(sibling->values[0]);
 
-        for (int i = 1; i < sibling->n; ++i)
-            sibling->keys[i - 1] = sibling->keys[i];
+        for (int i = 1; i < sibling->n; ++i) {
+            sibling->keys[i - 1] = std::move(sibling->keys[i]);
+            sibling->values[i - 1] = std::move(sibling->values[i]);
+        }
 
         if (!sibling->leaf) {
             for (int i = 1; i <= sibling->n; ++i)
@@ -176,22 +505,27 @@ class BTree {
     }
 
     // Function to merge two nodes
-    void merge(BTreeNode* node, int idx) {
-        BTreeNode* child = node->children[idx];
-        BTreeNode* sibling = node->children[idx + 1];
+    void merge(Node* node, int idx) {
+        Node* child = node->children[idx];
+        Node* sibling = node->children[idx + 1];
 
-        child->keys[ORDER / 2 - 1] = node->keys[idx];
+        child->keys[Order / 2 - 1] = std::move(node->keys[idx]);
+        child->values[Order / 2 - 1] = std::move(node->values[idx]);
 
-        for (int i = 0; i < sibling->n; ++i)
-            child->keys[i + ORDER / 2] = sibling->keys[i];
+        for (int i = 0; i < sibling->n; ++i) {
+            child->keys[i + Order / 2] = std::move(sibling->keys[i]);
+            child->values[i + Order / 2] = std::move(sibling->values[i]);
+        }
 
         if (!child->leaf) {
             for (int i = 0; i <= sibling->n; ++i)
-                child->children[i + ORDER / 2] = sibling->children[i];
+                child->children[i + Order / 2] = sibling->children[i];
         }
 
-        for (int i = idx + 1; i < node->n; ++i)
-            node->keys[i - 1] = node->keys[i];
+        for (int i = idx + 1; i < node->n; ++i) {
+            node->keys[i - 1] = std::move(node->keys[i]);
+            node->values[i - 1] = std::move(node->values[i]);
+        }
 
         for (int i = idx + 2; i <= node->n; ++i)
             node->children[i - 1] = node->children[i];
@@ -199,105 +533,267 @@ class BTree {
         child->n += sibling->n + 1;
         node->n--;
 
-        delete sibling;
+        pool.destroy(sibling);
     }
 
-    // Function to remove a key from a non-leaf node
-    void removeFromNonLeaf(BTreeNode* node, int idx) {
-        pair<uint8_t, uint8_t> k = node->keys[idx];
-
-        if (node->children[idx]->n >= ORDER / 2) {
-            pair<uint8_t, uint8_t> pred = getPredecessor(node, idx);
-            node->keys[idx] = pred;
-            remove(node->children[idx], pred);
-        } else if (node->children[idx + 1]->n >= ORDER / 2) {
-            pair<uint8_t, uint8_t> succ = getSuccessor(node, idx);
-            node->keys[idx] = succ;
-            remove(node->children[idx + 1], succ);
+    // Function to remove the key at idx from a non-leaf node. Returns the
+    // node to continue in and points k at the key left to remove there.
+    Node* removeFromNonLeaf(Node* node, int idx, const Key*& k) {
+        if (node->children[idx]->n >= Order / 2) {
+            Node* pred = getPredecessor(node, idx);
+            node->keys[idx] = pred->keys[pred->n - 1];
+            node->values[idx] = pred->values[pred->n - 1];
+            k = &node->keys[idx];
+            return node->children[idx];
+        } else if (node->children[idx + 1]->n >= Order / 2) {
+            Node* succ = getSuccessor(node, idx);
+            node->keys[idx] = succ->keys[0];
+            node->values[idx] = succ->values[0];
+            k = &node->keys[idx];
+            return node->children[idx + 1];
         } else {
+            // The key moves down into the merged child, still equal to *k
             merge(node, idx);
-            remove(node->children[idx], k);
+            return node->children[idx];
         }
     }
 
+    // Function to run the destructors of every node in a subtree
+    void destroySubtree(Node* x) {
+        if (!x->leaf)
+            for (int i = 0; i <= x->n; i++) destroySubtree(x->children[i]);
+        x->~Node();
+    }
+
     // Function to remove a key from a leaf node
-    void removeFromLeaf(BTreeNode* node, int idx) {
-        for (int i = idx + 1; i < node->n; ++i)
-            node->keys[i - 1] = node->keys[i];
+    void removeFromLeaf(Node* node, int idx) {
+        for (int i = idx + 1; i < node->n; ++i) {
+            node->keys[i - 1] = std::move(node->keys[i]);
+            node->values[i - 1] = std::move(node->values[i]);
+        }
 
         node->n--;
     }
 
-    // Function to remove a key from the tree
-    void remove(BTreeNode* node, pair<uint8_t, uint8_t> k) {
-        int idx = 0;
-        while (idx < node->n && node->keys[idx] < k) ++idx;
-
-        if (idx < node->n && node->keys[idx] == k) {
-            if (node->leaf)
-                removeFromLeaf(node, idx);
-            else
-                removeFromNonLeaf(node, idx);
-        } else {
-            if (node->leaf) {
-                cout << "The key (" << k.first << ", " << k.second
-                     << ") is not present in the tree\n";
-                return;
+    // Function to remove a key from the subtree rooted at node, topping up
+    // every child before descending into it. Once the key is found in an
+    // inner node, the walk continues for its predecessor or successor,
+    // which always sits in a subtree of the current node, so k may point
+    // at a key of a node above the walk.
+    bool remove(Node* node, const Key& key) {
+        const Key* k = &key;
+        bool found = false;
+        while (true) {
+            int idx = nodeSearch(node->keys, node->n, *k, comp);
+
+            if (idx < node->n && !comp(*k, node->keys[idx])) {
+                found = true;
+                if (node->leaf) {
+                    removeFromLeaf(node, idx);
+                    return true;
+                }
+                node = removeFromNonLeaf(node, idx, k);
+                continue;
             }
 
+            if (node->leaf) return found;
+
             bool flag = ((idx == node->n) ? true : false);
 
-            if (node->children[idx]->n < ORDER / 2) fill(node, idx);
+            if (node->children[idx]->n < Order / 2) fill(node, idx);
 
             if (flag && idx > node->n)
-                remove(node->children[idx - 1], k);
+                node = node->children[idx - 1];
             else
-                remove(node->children[idx], k);
+                node = node->children[idx];
         }
     }
 
+    // Function to compute b^h, saturating at limit
+    static uint64_t power(uint64_t b, int h, uint64_t limit) {
+        uint64_t r = 1;
+        for (int i = 0; i < h && r <= limit; i++) r *= b;
+        return std::min(r, limit + 1);
+    }
+
+    // Function to build a subtree of height h over the next w - 1 entries of
+    // it. A subtree of height h holding w - 1 keys splits its w "units" among
+    // its children, each child taking its own keys plus one for the
+    // separator that follows it. Children get an even share of the units,
+    // aiming for target children per node while keeping every node between
+    // Order / 2 - 1 and Order - 1 keys.
+    template <typename It>
+    Node* bulkBuild(It& it, uint64_t w, int h, uint64_t target, bool isRoot) {
+        if (h == 1) {
+            Node* x = pool.create(true);
+            for (uint64_t i = 0; i + 1 < w; i++, ++it) {
+                x->keys[i] = it->first;
+                x->values[i] = it->second;
+            }
+            x->n = static_cast<int>(w - 1);
+            return x;
+        }
+
+        uint64_t most = power(Order, h - 1, w);
+        uint64_t least = power(Order / 2, h - 1, w);
+        uint64_t lo = std::max<uint64_t>(isRoot ? 2 : Order / 2,
+                                         (w + most - 1) / most);
+        uint64_t hi = std::min<uint64_t>(Order, w / least);
+        uint64_t want = power(target, h - 1, w);
+        uint64_t c = std::min(hi, std::max(lo, (w + want - 1) / want));
+
+        Node* x = pool.create(false);
+        for (uint64_t i = 0; i < c; i++) {
+            uint64_t share = w / c + (i < w % c ? 1 : 0);
+            x->children[i] = bulkBuild(it, share, h - 1, target, false);
+            if (i + 1 < c) {
+                x->keys[i] = it->first;
+                x->values[i] = it->second;
+                ++it;
+            }
+        }
+        x->n = static_cast<int>(c - 1);
+        return x;
+    }
+
    public:
-    BTree() { root = new BTreeNode(true); }
+    BTree(const Compare& compare = Compare()) : comp(compare) {}
+
+    BTree(const BTree&) = delete;
+    BTree& operator=(const BTree&) = delete;
+
+    BTree(BTree&& other) noexcept
+        : root(std::exchange(other.root, nullptr)),
+          count(std::exchange(other.count, 0)),
+          comp(std::move(other.comp)),
+          pool(std::move(other.pool)) {}
+
+    BTree& operator=(BTree&& other) noexcept {
+        if (this != &other) {
+            clear();
+            root = std::exchange(other.root, nullptr);
+            count = std::exchange(other.count, 0);
+            comp = std::move(other.comp);
+            pool = std::move(other.pool);
+        }
+        return *this;
+    }
+
+    ~BTree() { clear(); }
+
+    // Function to drop every key. Nodes are freed in bulk; for trivially
+    // destructible keys and values this does not walk the tree at all.
+    void clear() {
+        if constexpr (!std::is_trivially_destructible_v<Node>) {
+            if (root != nullptr) destroySubtree(root);
+        }
+        pool.release();
+        root = nullptr;
+        count = 0;
+    }
+
+    /**
+     * @brief Replaces the contents with a sorted range of (key, value) pairs
+     *        in one bottom-up pass.
+     *
+     * Nodes are filled to about fill * (Order - 1) keys, clamped to what a
+     * B-tree allows, and the tree has the least height that fill permits.
+     * A fill below 1 leaves room for later inserts without splits.
+     *
+     * @throws std::invalid_argument if the keys are not strictly increasing.
+     */
+    template <typename It>
+    void bulkLoad(It first, It last, double fill = 1.0) {
+        uint64_t n = 0;
+        for (It it = first, prev = first; it != last; prev = it++, ++n) {
+            if (n > 0 && !comp(prev->first, it->first))
+                throw std::invalid_argument(
+                    "BTree::bulkLoad: keys must be sorted and unique");
+        }
+
+        clear();
+        if (n == 0) return;
+
+        // Target children per node, at least the B-tree minimum of Order / 2.
+        uint64_t target =
+            static_cast<uint64_t>(std::lround(fill * (Order - 1))) + 1;
+        target =
+            std::min<uint64_t>(Order, std::max<uint64_t>(Order / 2, target));
+
+        // Least height whose nodes hold n keys at the target fill, lowered
+        // again while the root could not have two children.
+        int h = 1;
+        while (power(target, h, n + 1) < n + 1) h++;
+        while (h > 1 && n + 1 < 2 * power(Order / 2, h - 1, n + 1)) h--;
+
+        root = bulkBuild(first, n + 1, h, target, true);
+        count = n;
+    }
+
+    // Function to insert a key in the tree, replacing the value of an
+    // existing equal key
+    void insert(const Key& k, const Value& v) {
+        if (root == nullptr) root = pool.create(true);
 
-    // Function to insert a key in the tree
-    void insert(pair<uint8_t, uint8_t> k) {
-        if (root->n == ORDER - 1) {
-            BTreeNode* s = new BTreeNode(false);
+        // Splitting a full root is harmless even if k turns out to exist.
+        if (root->n == Order - 1) {
+            Node* s = pool.create(false);
             s->children[0] = root;
             root = s;
             splitChild(s, 0);
-            insertNonFull(s, k);
-        } else
-            insertNonFull(root, k);
+        }
+        if (insertNonFull(root, k, v)) ++count;
     }
 
-    // Function to traverse the tree
-    void traverse() {
-        if (root != nullptr) traverse(root);
+    // Function to traverse the tree, calling visit(key, value) in key order
+    template <typename Visit>
+    void traverse(Visit visit) const {
+        if (root != nullptr) traverse(root, visit);
     }
 
     // Function to search a key in the tree
-    BTreeNode* search(pair<uint8_t, uint8_t> k) {
-        return (root == nullptr) ? nullptr : search(root, k);
+    std::optional<Value> search(const Key& k) const {
+        if (root == nullptr) return std::nullopt;
+        const Value* v = search(root, k);
+        if (v == nullptr) return std::nullopt;
+        return *v;
     }
 
-    // Function to remove a key from the tree
-    void remove(pair<uint8_t, uint8_t> k) {
-        if (!root) {
-            cout << "The tree is empty\n";
-            return;
-        }
+    // Function to check whether a key is in the tree
+    bool contains(const Key& k) const {
+        return root != nullptr && search(root, k) != nullptr;
+    }
+
+    // Function to remove a key from the tree, returns false if it was absent
+    bool remove(const Key& k) {
+        if (!root) return false;
 
-        remove(root, k);
+        bool removed = remove(root, k);
+        if (removed) --count;
 
         if (root->n == 0) {
-            BTreeNode* tmp = root;
+            Node* tmp = root;
             if (root->leaf)
                 root = nullptr;
             else
                 root = root->children[0];
 
-            delete tmp;
+            pool.destroy(tmp);
         }
+        return removed;
     }
-};
\ No newline at end of file
+
+    // Number of keys in the tree
+    size_t size() const { return count; }
+
+    // Number of levels, 0 for an empty tree
+    int height() const {
+        int h = 0;
+        for (const Node* x = root; x != nullptr; h++)
+            x = x->leaf ? nullptr : x->children[0];
+        return h;
+    }
+
+    // Bytes held by the node pool
+    size_t bytes() const { return pool.bytes(); }
+};
@@ -1,4 +1,5 @@
 #pragma once
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
@@ -9,6 +10,7 @@
 #include <utility>
 #include <vector>
 
+#include "blocked_bloom.h"
 #include "hash_base.h"
 
 /**
@@ -16,18 +18,46 @@
  *
  * Supports insert, lookup, update, remove, clear, and dynamic expansion.
  * Achieves O(1) amortized and O(log(1/δ)) worst-case expected probe complexity.
+ *
+ * Slots live in segments, each one allocation of entries with keys and
+ * values stored inline, and a level is a range of one segment. Slot states
+ * live in a separate one-byte array per segment, so a probe reads one state
+ * byte and touches an entry only when the slot is occupied. K and V must be
+ * default-constructible.
+ *
+ * By default growth rebuilds the table at twice the size, with all levels
+ * in a single segment. With Growth::AddLevel it adds a level instead: a
+ * table of size 2n has a level of size n followed by exactly the levels of
+ * a table of size n, so doubling allocates the new largest level as a
+ * segment of its own and leaves the existing entries where they are,
+ * neither moved nor rehashed. That is cheaper than a rebuild, but keeps
+ * older keys spread over the smaller levels, which makes hits slower than
+ * after a rebuild.
+ *
+ * Removed entries leave Deleted tombstones, which inserts reuse. Once they
+ * exceed a quarter of the capacity, the table is rebuilt at the same size
+ * to clear them.
+ *
+ * With Filtered set, each level also keeps a blocked Bloom filter of the
+ * keys inserted into it, and searches skip levels whose filter rules the
+ * key out. This costs one byte per slot and mostly speeds up misses.
  */
 
-template <typename K, typename V>
+template <typename K, typename V, bool Filtered = false>
 class ElasticHash : public HashBase<K, V> {
    public:
     using KeyType = K;
     using ValueType = V;
 
+    // How expand() doubles the capacity.
+    enum class Growth { Rebuild, AddLevel };
+
     ElasticHash() : ElasticHash(DEFAULT_CAPACITY, 0.1) {}
 
-    explicit ElasticHash(size_t n, double delta = 0.1)
-        : total_size_(n), delta_(delta), inserts_done_(0) {
+    explicit ElasticHash(size_t n, double delta = 0.1,
+                         Growth growth = Growth::Rebuild)
+        : total_size_(n), delta_(delta), inserts_done_(0), growth_(growth) {
+        logInvDelta_ = size_t(std::ceil(std::log2(1.0 / delta_)));
         buildLevels(n);
         computeTargets();
     }
@@ -39,30 +69,32 @@ class ElasticHash : public HashBase<K, V> {
             return;
         }
 
-        size_t lvl = currentBatch();
+        size_t lvl = batch_;
+        uint64_t h = std::hash<K>{}(key);
+        ProbeSeq first = probeSeq(lvl, h), second = probeSeq(lvl + 1, h);
+        auto [en1, st1] = slotsOf(*this, lvl);
+        auto [en2, st2] = slotsOf(*this, lvl + 1);
 
-        double eps1 =
-            double(slots_[lvl].size() - occupied_[lvl]) / slots_[lvl].size();
-        double eps2 = double(slots_[lvl + 1].size() - occupied_[lvl + 1]) /
-                      slots_[lvl + 1].size();
-        size_t tries = probes_(std::min(eps1, eps2));
+        // eps1 > δ/2 and eps2 > 1/4, as occupancy against the batch targets
+        bool roomy1 = occupied_[lvl] < fullTarget_[lvl];
+        bool roomy2 = occupied_[lvl + 1] < partialTarget_[lvl + 1];
+        size_t tries = std::max(probeBudget(lvl), probeBudget(lvl + 1));
 
         bool placed = false;
 
-        if (eps1 > delta_ / 2 && eps2 > 0.25) {
+        if (roomy1 && roomy2) {
             for (size_t j = 0; j < tries; ++j) {
-                size_t idx = hashPos(lvl, key, j);
-                auto &e = slots_[lvl][idx];
+                size_t idx = first(j);
 
-                if (e.state == State::Occupied) {
-                    if (e.kv->first == key) {
-                        e.kv->second = value;
+                if (st1[idx] == State::Occupied) {
+                    if (en1[idx].key == key) {
+                        en1[idx].value = value;
                         return;
                     }
                     continue;
                 }
 
-                place(lvl, idx, key, value);
+                place(lvl, j, idx, h, key, value);
                 placed = true;
                 break;
             }
@@ -70,16 +102,15 @@ class ElasticHash : public HashBase<K, V> {
             if (!placed) {
                 uint64_t j = 0;
                 for (;; ++j) {
-                    size_t idx = hashPos(lvl + 1, key, j);
-                    auto &e = slots_[lvl + 1][idx];
-                    if (e.state == State::Occupied) {
-                        if (e.kv->first == key) {
-                            e.kv->second = value;
+                    size_t idx = second(j);
+                    if (st2[idx] == State::Occupied) {
+                        if (en2[idx].key == key) {
+                            en2[idx].value = value;
                             return;
                         }
                         continue;
                     }
-                    place(lvl + 1, idx, key, value);
+                    place(lvl + 1, j, idx, h, key, value);
                     placed = true;
                     break;
                 }
@@ -91,19 +122,18 @@ class ElasticHash : public HashBase<K, V> {
             }
         }
 
-        else if (eps1 <= delta_ / 2) {
+        else if (!roomy1) {
             uint64_t j = 0;
             for (;; ++j) {
-                size_t idx = hashPos(lvl + 1, key, j);
-                auto &e = slots_[lvl + 1][idx];
-                if (e.state == State::Occupied) {
-                    if (e.kv->first == key) {
-                        e.kv->second = value;
+                size_t idx = second(j);
+                if (st2[idx] == State::Occupied) {
+                    if (en2[idx].key == key) {
+                        en2[idx].value = value;
                         return;
                     }
                     continue;
                 }
-                place(lvl + 1, idx, key, value);
+                place(lvl + 1, j, idx, h, key, value);
                 placed = true;
                 break;
             }
@@ -117,16 +147,15 @@ class ElasticHash : public HashBase<K, V> {
         else {
             uint64_t j = 0;
             for (;; ++j) {
-                size_t idx = hashPos(lvl, key, j);
-                auto &e = slots_[lvl][idx];
-                if (e.state == State::Occupied) {
-                    if (e.kv->first == key) {
-                        e.kv->second = value;
+                size_t idx = first(j);
+                if (st1[idx] == State::Occupied) {
+                    if (en1[idx].key == key) {
+                        en1[idx].value = value;
                         return;
                     }
                     continue;
                 }
-                place(lvl, idx, key, value);
+                place(lvl, j, idx, h, key, value);
                 placed = true;
                 break;
             }
@@ -138,36 +167,44 @@ class ElasticHash : public HashBase<K, V> {
         }
 
         ++inserts_done_;
+        advanceBatch();
     }
 
     std::optional<V> lookup(const K &key) const override {
-        for (size_t lvl = 0; lvl + 1 < slots_.size(); ++lvl) {
-            size_t limit = probes_(delta_);
-            for (size_t j = 0; j < limit + 10; ++j) {
-                size_t idx = hashPos(lvl, key, j);
-                const auto &e = slots_[lvl][idx];
-
-                if (e.state == State::Empty) break;
-
-                if (e.state == State::Occupied && e.kv->first == key)
-                    return e.kv->second;
+        uint64_t h = std::hash<K>{}(key);
+        for (size_t lvl = 0; lvl < numLevels(); ++lvl) {
+            if (occupied_[lvl] == 0) continue;
+            ProbeSeq probe = probeSeq(lvl, h);
+            if constexpr (Filtered)
+                if (!filters_[lvl].mayContain(probe.start)) continue;
+            auto [en, st] = slotsOf(*this, lvl);
+            for (size_t j = 0; j < probeLen_[lvl]; ++j) {
+                size_t idx = probe(j);
+
+                if (st[idx] == State::Empty) break;
+
+                if (st[idx] == State::Occupied && en[idx].key == key)
+                    return en[idx].value;
             }
         }
         return std::nullopt;
     }
 
     bool update(const K &key, const V &value) override {
-        for (size_t lvl = 0; lvl + 1 < slots_.size(); ++lvl) {
-            size_t limit = probes_(delta_);
-
-            for (size_t j = 0; j < limit + 10; ++j) {
-                size_t idx = hashPos(lvl, key, j);
-                auto &e = slots_[lvl][idx];
-
-                if (e.state == State::Empty) break;
-
-                if (e.state == State::Occupied && e.kv->first == key) {
-                    e.kv->second = value;
+        uint64_t h = std::hash<K>{}(key);
+        for (size_t lvl = 0; lvl < numLevels(); ++lvl) {
+            if (occupied_[lvl] == 0) continue;
+            ProbeSeq probe = probeSeq(lvl, h);
+            if constexpr (Filtered)
+                if (!filters_[lvl].mayContain(probe.start)) continue;
+            auto [en, st] = slotsOf(*this, lvl);
+            for (size_t j = 0; j < probeLen_[lvl]; ++j) {
+                size_t idx = probe(j);
+
+                if (st[idx] == State::Empty) break;
+
+                if (st[idx] == State::Occupied && en[idx].key == key) {
+                    en[idx].value = value;
                     return true;
                 }
             }
@@ -176,19 +213,29 @@ class ElasticHash : public HashBase<K, V> {
     }
 
     bool remove(const K &key) override {
-        for (size_t lvl = 0; lvl + 1 < slots_.size(); ++lvl) {
-            size_t limit = probes_(delta_);
-
-            for (size_t j = 0; j < limit + 10; ++j) {
-                size_t idx = hashPos(lvl, key, j);
-                auto &e = slots_[lvl][idx];
-
-                if (e.state == State::Empty) break;
-
-                if (e.state == State::Occupied && e.kv->first == key) {
-                    e.state = State::Deleted;
-                    e.kv.reset();
+        uint64_t h = std::hash<K>{}(key);
+        for (size_t lvl = 0; lvl < numLevels(); ++lvl) {
+            if (occupied_[lvl] == 0) continue;
+            ProbeSeq probe = probeSeq(lvl, h);
+            if constexpr (Filtered)
+                if (!filters_[lvl].mayContain(probe.start)) continue;
+            auto [en, st] = slotsOf(*this, lvl);
+            for (size_t j = 0; j < probeLen_[lvl]; ++j) {
+                size_t idx = probe(j);
+
+                if (st[idx] == State::Empty) break;
+
+                if (st[idx] == State::Occupied && en[idx].key == key) {
+                    st[idx] = State::Deleted;
+                    en[idx] = Entry();
                     --occupied_[lvl];
+                    --inserts_done_;
+                    ++tombstones_;
+                    // Level lvl may be the batch's first or second level.
+                    batch_ = std::min(batch_, lvl > 0 ? lvl - 1 : 0);
+                    advanceBatch();
+                    if (tombstones_ > total_size_ * MAX_TOMBSTONE_RATIO)
+                        rehash(total_size_);
                     return true;
                 }
             }
@@ -198,15 +245,22 @@ class ElasticHash : public HashBase<K, V> {
 
     size_t size() const override { return inserts_done_; }
 
+    // Deleted slots not yet reused or cleared by a rebuild.
+    size_t tombstones() const { return tombstones_; }
+
     void clear() override {
-        for (auto &lvl : slots_) {
-            for (auto &e : lvl) {
-                e.state = State::Empty;
-                e.kv.reset();
-            }
+        for (Segment &seg : segments_) {
+            for (size_t at = 0; at < seg.state.size(); ++at)
+                if (seg.state[at] == State::Occupied) seg.entries[at] = Entry();
+            seg.state.assign(seg.state.size(), State::Empty);
         }
         occupied_.assign(occupied_.size(), 0);
+        probeLen_.assign(probeLen_.size(), 0);
+        for (auto &f : filters_) f.clear();
         inserts_done_ = 0;
+        tombstones_ = 0;
+        batch_ = 0;
+        advanceBatch();
     }
 
     double loadFactor() const override {
@@ -215,13 +269,21 @@ class ElasticHash : public HashBase<K, V> {
 
     size_t capacity() const override { return total_size_; }
 
+    // Memory held by the per-level filters; 0 unless Filtered.
+    size_t filterBytes() const {
+        size_t bytes = 0;
+        for (const auto &f : filters_) bytes += f.bytes();
+        return bytes;
+    }
+
     void debugPrint() const {
-        for (size_t i = 0; i < slots_.size(); ++i) {
+        for (size_t i = 0; i < numLevels(); ++i) {
             std::cout << "Level " << i << ": ";
-            for (const auto &e : slots_[i]) {
-                if (e.state == State::Occupied) {
-                    std::cout << "(" << e.kv->first << ") ";
-                } else if (e.state == State::Deleted) {
+            auto [en, st] = slotsOf(*this, i);
+            for (size_t idx = 0; idx < levelSize(i); ++idx) {
+                if (st[idx] == State::Occupied) {
+                    std::cout << "(" << en[idx].key << ") ";
+                } else if (st[idx] == State::Deleted) {
                     std::cout << "[D] ";
                 } else {
                     std::cout << "[E] ";
@@ -234,63 +296,110 @@ class ElasticHash : public HashBase<K, V> {
    private:
     static constexpr size_t DEFAULT_CAPACITY = 1024;
     static constexpr size_t PROBE_MULTIPLIER = 4;
+    static constexpr double MAX_TOMBSTONE_RATIO = 0.25;
 
-    enum class State { Empty, Occupied, Deleted };
+    enum class State : uint8_t { Empty, Occupied, Deleted };
     struct Entry {
-        State state = State::Empty;
-        std::optional<std::pair<K, V>> kv;
+        K key;
+        V value;
     };
 
-    std::vector<std::vector<Entry>> slots_;
+    // One allocation of slots, holding one or more whole levels.
+    struct Segment {
+        std::vector<Entry> entries;
+        std::vector<State> state;    // one byte per entry
+    };
+    // A level is [offset, offset + size) of one segment.
+    struct Level {
+        size_t segment, offset, size;
+    };
+
+    std::vector<Segment> segments_;
+    std::vector<Level> levels_;      // level 0 is the largest
     std::vector<size_t> occupied_, fullTarget_, partialTarget_;
+    // Longest probe sequence any insert has used in each level. A key that
+    // is present in a level sits within that many probes, so searches stop
+    // there instead of at a fixed cap.
+    std::vector<size_t> probeLen_;
+    std::vector<BlockedBloomFilter> filters_;  // one per level if Filtered
     size_t total_size_;
     double delta_;
-    size_t inserts_done_;
+    size_t inserts_done_;             // live entries
+    size_t tombstones_ = 0;
+    size_t batch_ = 0;                // first level of the current batch
+    size_t logInvDelta_;              // ceil(log2(1/δ))
+    Growth growth_;
 
     void buildLevels(size_t n) {
-        slots_.clear();
+        levels_.clear();
         occupied_.clear();
 
-        size_t remaining = n;
+        size_t remaining = n, offset = 0;
         while (remaining > 0) {
             size_t levelSize = (remaining + 1) / 2;
-            slots_.emplace_back(levelSize);
+            levels_.push_back({0, offset, levelSize});
             occupied_.push_back(0);
+            offset += levelSize;
             remaining -= levelSize;
         }
+
+        // One segment for all levels.
+        segments_.clear();
+        segments_.push_back({std::vector<Entry>(n),
+                             std::vector<State>(n, State::Empty)});
+        probeLen_.assign(occupied_.size(), 0);
+        filters_.clear();
+        if constexpr (Filtered)
+            for (size_t i = 0; i < numLevels(); ++i)
+                filters_.emplace_back(levelSize(i));
+    }
+
+    size_t numLevels() const { return levels_.size(); }
+
+    size_t levelSize(size_t lvl) const { return levels_[lvl].size; }
+
+    // Entry and state arrays of level lvl, const when the table is.
+    template <typename Self>
+    static auto slotsOf(Self &self, size_t lvl) {
+        const Level &l = self.levels_[lvl];
+        auto &seg = self.segments_[l.segment];
+        return std::make_pair(seg.entries.data() + l.offset,
+                              seg.state.data() + l.offset);
     }
 
     void computeTargets() {
-        size_t L = slots_.size();
+        size_t L = numLevels();
         fullTarget_.resize(L);
         partialTarget_.resize(L);
         for (size_t i = 0; i < L; ++i) {
-            size_t sz = slots_[i].size();
+            size_t sz = levelSize(i);
             fullTarget_[i] = sz - size_t(std::floor(delta_ * sz / 2));
             partialTarget_[i] = size_t(std::ceil(0.75 * sz));
         }
+        batch_ = 0;
+        advanceBatch();
     }
 
-    size_t currentBatch() const {
-        size_t L = slots_.size();
-        for (size_t i = 0; i + 1 < L; ++i) {
-            if (occupied_[i] < fullTarget_[i] ||
-                occupied_[i + 1] < partialTarget_[i + 1])
-                return i;
-        }
-        return L - 2;
+    // The batch is the first level i that is not yet filled to its target
+    // or whose successor is not yet 3/4 full, or L-2 once all are. Inserts
+    // only raise occupancy, so the index moves forward; remove() moves it
+    // back before calling this.
+    void advanceBatch() {
+        size_t L = numLevels();
+        while (batch_ + 2 < L && occupied_[batch_] >= fullTarget_[batch_] &&
+               occupied_[batch_ + 1] >= partialTarget_[batch_ + 1])
+            ++batch_;
     }
 
-    size_t probes_(double eps) const {
-        if (eps <= 0) {
-            double mx = std::log2(1.0 / delta_);
-            return PROBE_MULTIPLIER * size_t(std::ceil(mx));
-        }
-        size_t base = size_t(
-            std::ceil(std::min(std::log2(1 / eps), std::log2(1 / delta_))));
-        return base * PROBE_MULTIPLIER;
+    // PROBE_MULTIPLIER * ceil(min(log2(1/eps), log2(1/δ))) for the level's
+    // free fraction eps, without floating point: ceil(log2(size/free)) is
+    // the least k with free * 2^k >= size.
+    size_t probeBudget(size_t lvl) const {
+        size_t sz = levelSize(lvl), free = sz - occupied_[lvl];
+        size_t k = 0;
+        while (k < logInvDelta_ && (free << k) < sz) ++k;
+        return k * PROBE_MULTIPLIER;
     }
-    size_t maxProbes() const { return probes_(delta_); }
 
     static uint64_t splitmix64(uint64_t x) {
         x += 0x9e3779b97f4a7c15ULL;
@@ -299,31 +408,77 @@ class ElasticHash : public HashBase<K, V> {
         return x ^ (x >> 31);
     }
 
-    size_t hashPos(size_t lvl, const K &key, size_t j) const {
-        uint64_t h = std::hash<K>{}(key);
-        uint64_t a = splitmix64(h ^ (uint64_t)lvl);
-        uint64_t b = splitmix64(h ^ (uint64_t)j);
-        uint64_t idx = splitmix64(a ^ b);
-        return idx % slots_[lvl].size();
+    // Probe sequence of one key in one level. The key is hashed once per
+    // operation; each level seeds an arithmetic sequence from that hash and
+    // every probe scrambles its term with a single multiply, so probes stay
+    // spread over the whole level.
+    struct ProbeSeq {
+        uint64_t start, step;
+        size_t size;
+
+        size_t operator()(size_t j) const {
+            uint64_t x = start + j * step;
+            x = (x ^ (x >> 32)) * 0xd6e8feb86659fd93ULL;
+            return size_t((x ^ (x >> 32)) % size);
+        }
+    };
+
+    // The sequence starts at a per-level remix of the key's hash, which
+    // also keys the level's filter. Levels are told apart by their distance
+    // from the smallest level, which expand() does not change.
+    ProbeSeq probeSeq(size_t lvl, uint64_t h) const {
+        uint64_t id = numLevels() - 1 - lvl;
+        uint64_t a = splitmix64(h ^ (id * 0x9e3779b97f4a7c15ULL));
+        return {a, splitmix64(a) | 1, levelSize(lvl)};
     }
 
-    void place(size_t lvl, size_t idx, const K &key, const V &val) {
-        slots_[lvl][idx].state = State::Occupied;
-        slots_[lvl][idx].kv = {key, val};
+    // Stores the entry at slot idx of level lvl, reached by probe j of the
+    // sequence for hash h.
+    void place(size_t lvl, size_t j, size_t idx, uint64_t h, const K &key,
+               const V &val) {
+        auto [en, st] = slotsOf(*this, lvl);
+        if (st[idx] == State::Deleted) --tombstones_;
+        probeLen_[lvl] = std::max(probeLen_[lvl], j + 1);
+        if constexpr (Filtered) filters_[lvl].add(probeSeq(lvl, h).start);
+        st[idx] = State::Occupied;
+        en[idx] = {key, val};
         ++occupied_[lvl];
     }
 
+    // With Growth::AddLevel, doubles the capacity by adding a level of the
+    // current size in front, in a segment of its own. Existing entries stay
+    // where they are; nothing is moved or rehashed.
     void expand() {
+        if (growth_ == Growth::Rebuild) {
+            rehash(total_size_ * 2);
+            return;
+        }
+        size_t sz = total_size_;
         total_size_ *= 2;
-        std::vector<std::pair<K, V>> items;
-        items.reserve(inserts_done_);
-        for (auto &lvl : slots_)
-            for (auto &e : lvl)
-                if (e.state == State::Occupied) items.push_back(*e.kv);
+        segments_.push_back({std::vector<Entry>(sz),
+                             std::vector<State>(sz, State::Empty)});
+        levels_.insert(levels_.begin(), {segments_.size() - 1, 0, sz});
+        occupied_.insert(occupied_.begin(), 0);
+        probeLen_.insert(probeLen_.begin(), 0);
+        if constexpr (Filtered) filters_.emplace(filters_.begin(), sz);
+        computeTargets();
+    }
+
+    // Rebuilds all levels for capacity n and reinserts the live entries,
+    // dropping every tombstone.
+    void rehash(size_t n) {
+        total_size_ = n;
+        // Reinsert straight from the old segments, no staging copy.
+        std::vector<Segment> old;
+        old.swap(segments_);
         buildLevels(total_size_);
         computeTargets();
         inserts_done_ = 0;
-        for (auto &kv : items) insert(kv.first, kv.second);
+        tombstones_ = 0;
+        for (const Segment &seg : old)
+            for (size_t at = 0; at < seg.state.size(); ++at)
+                if (seg.state[at] == State::Occupied)
+                    insert(seg.entries[at].key, seg.entries[at].value);
     }
 
     static size_t nextPow2(size_t n) {
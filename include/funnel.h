@@ -9,6 +9,11 @@
 #include <utility>
 #include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "blocked_bloom.h"
 #include "hash_base.h"
 
 /**
@@ -16,8 +21,18 @@
  *
  * Supports insert, lookup, update, remove, clear, and dynamic expansion.
  * Achieves O(log^2(1/δ)) worst-case and O(log(1/δ)) amortized expected probes.
+ *
+ * Entries are stored inline and every slot has a one-byte tag: empty,
+ * deleted, or a fingerprint of the occupant's hash. The tags of a bucket
+ * sit together in one 16-byte group that never straddles a cache line, so
+ * a bucket is searched with one SIMD compare and keys are read only on a
+ * fingerprint match. K and V must be default-constructible.
+ *
+ * With Filtered set, every level including the overflow keeps a blocked
+ * Bloom filter of its keys, and lookups and removes skip levels whose filter
+ * rules the key out. This costs one byte per slot and mostly speeds up misses.
  */
-template <typename K, typename V>
+template <typename K, typename V, bool Filtered = false>
 class FunnelHash : public HashBase<K, V> {
    public:
     using KeyType = K;
@@ -30,100 +45,63 @@ class FunnelHash : public HashBase<K, V> {
         // Compute number of levels α and bucket size β (paper Sec.3)
         alpha_ = size_t(std::ceil(4 * std::log2(1.0 / delta_) + 10));
         beta_ = size_t(std::ceil(std::log2(1.0 / delta_)));
+        if (beta_ > TAG_GROUP)
+            throw std::invalid_argument("FunnelHash: delta too small");
         buildLevels(n < DEFAULT_CAPACITY ? DEFAULT_CAPACITY : n);
     }
 
     void insert(const K &key, const V &value) override {
-        // Expand if load exceeds (1-δ)
-        if (inserts_done_ + 1 > total_size_ * (1 - delta_)) {
-            expand();
-            insert(key, value);
-            return;
-        }
-        // Greedy tries on levels A1..Aα
-        for (size_t lvl = 0; lvl < alpha_; ++lvl) {
-            size_t nbuckets = slots_[lvl].size() / beta_;
-            size_t b = hashToBucket(lvl, std::hash<K>{}(key)) % nbuckets;
-            size_t start = b * beta_;
-            // scan bucket of size β
-            for (size_t j = 0; j < beta_; ++j) {
-                Entry &e = slots_[lvl][start + j];
-                if (e.state == State::Occupied) {
-                    if (e.kv->first == key) {
-                        e.kv->second = value;  // update existing
-                        return;
-                    }
-                    continue;
-                }
-                // empty or deleted -> place here
-                place(lvl, start + j, key, value);
-                ++inserts_done_;
-                return;
-            }
-        }
-        // Overflow level A_{α+1}
-        // First half: uniform probing with up to O(log log n) attempts
-        insertOverflow(key, value);
+        insertHashed(key, value, std::hash<K>{}(key));
     }
 
     std::optional<V> lookup(const K &key) const override {
-        // search each level greedily (paper Sec.3)
-        for (size_t lvl = 0; lvl < alpha_; ++lvl) {
-            size_t nbuckets = slots_[lvl].size() / beta_;
-            size_t b = hashToBucket(lvl, std::hash<K>{}(key)) % nbuckets;
-            size_t start = b * beta_;
-            for (size_t j = 0; j < beta_; ++j) {
-                const Entry &e = slots_[lvl][start + j];
-                if (e.state == State::Empty) break;
-                if (e.state == State::Occupied && e.kv->first == key)
-                    return e.kv->second;
-            }
-        }
-        return lookupOverflow(key);
+        return lookupHashed(key, std::hash<K>{}(key));
     }
 
     bool update(const K &key, const V &value) override {
-        auto opt = lookup(key);
-        if (!opt) return false;
-        insert(key, value);
+        uint64_t h = std::hash<K>{}(key);
+        if (!lookupHashed(key, h)) return false;
+        insertHashed(key, value, h);
         return true;
     }
 
     bool remove(const K &key) override {
-        for (size_t lvl = 0; lvl < slots_.size(); ++lvl) {
-            size_t start = 0, sz = slots_[lvl].size();
-            if (lvl < alpha_) {
-                size_t nbuckets = sz / beta_;
-                size_t b = hashToBucket(lvl, std::hash<K>{}(key)) % nbuckets;
-                start = b * beta_;
-                sz = beta_;
-            } else {
-                // search all overflow
-                sz = slots_[lvl].size();
-            }
-            for (size_t j = 0; j < sz; ++j) {
-                Entry &e = slots_[lvl][start + j];
-                if (e.state == State::Empty) break;
-                if (e.state == State::Occupied && e.kv->first == key) {
-                    e.state = State::Deleted;
-                    e.kv.reset();
+        uint64_t h = std::hash<K>{}(key);
+        for (size_t lvl = 0; lvl < alpha_; ++lvl) {
+            uint64_t lh = hashToBucket(lvl, h);
+            if constexpr (Filtered)
+                if (!filters_[lvl].mayContain(lh)) continue;
+            size_t b = fastrange(lh, groups_[lvl].size());
+            TagGroup &g = groups_[lvl][b];
+            for (uint32_t m = matchTags(g, tagOf(lh)); m; m &= m - 1) {
+                size_t j = size_t(__builtin_ctz(m));
+                Entry &e = entries_[lvl][b * beta_ + j];
+                if (e.key == key) {
+                    g.tag[j] = DELETED;
+                    e = Entry();
                     --occupied_[lvl];
                     return true;
                 }
             }
         }
-        return false;
+        size_t idx = findOverflow(key, h);
+        if (idx == NOT_FOUND) return false;
+        overflowTags_[idx] = DELETED;
+        entries_[alpha_][idx] = Entry();
+        --occupied_[alpha_];
+        return true;
     }
 
     size_t size() const override { return inserts_done_; }
 
     void clear() override {
-        for (auto &lvl : slots_)
-            for (auto &e : lvl) {
-                e.state = State::Empty;
-                e.kv.reset();
-            }
+        for (auto &level : groups_)
+            for (auto &g : level) g = TagGroup();
+        overflowTags_.assign(overflowTags_.size(), EMPTY);
+        for (auto &level : entries_)
+            for (auto &e : level) e = Entry();
         occupied_.assign(occupied_.size(), 0);
+        for (auto &f : filters_) f.clear();
         inserts_done_ = 0;
     }
 
@@ -132,13 +110,21 @@ class FunnelHash : public HashBase<K, V> {
     }
     size_t capacity() const override { return total_size_; }
 
+    // Memory held by the per-level filters; 0 unless Filtered.
+    size_t filterBytes() const {
+        size_t bytes = 0;
+        for (const auto &f : filters_) bytes += f.bytes();
+        return bytes;
+    }
+
     void debugPrint() const {
-        for (size_t i = 0; i < slots_.size(); ++i) {
+        for (size_t i = 0; i < entries_.size(); ++i) {
             std::cout << "Level " << i << ": ";
-            for (const auto &e : slots_[i]) {
-                if (e.state == State::Occupied) {
-                    std::cout << "(" << e.kv->first << ") ";
-                } else if (e.state == State::Deleted) {
+            for (size_t idx = 0; idx < entries_[i].size(); ++idx) {
+                uint8_t t = tagAt(i, idx);
+                if (t > DELETED) {
+                    std::cout << "(" << entries_[i][idx].key << ") ";
+                } else if (t == DELETED) {
                     std::cout << "[D] ";
                 } else {
                     std::cout << "[E] ";
@@ -150,21 +136,41 @@ class FunnelHash : public HashBase<K, V> {
 
    private:
     static constexpr size_t DEFAULT_CAPACITY = 64;
-    enum class State { Empty, Occupied, Deleted };
+    // Slot tags; any other value is the fingerprint of an occupied slot.
+    static constexpr uint8_t EMPTY = 0, DELETED = 1;
+    static constexpr size_t TAG_GROUP = 16;  // one SSE2 register
+    static constexpr size_t NOT_FOUND = SIZE_MAX;
+
     struct Entry {
-        State state = State::Empty;
-        std::optional<std::pair<K, V>> kv;
+        K key;
+        V value;
+    };
+    // Tags of one bucket; only the first β are used.
+    struct alignas(TAG_GROUP) TagGroup {
+        uint8_t tag[TAG_GROUP] = {};
     };
 
-    std::vector<std::vector<Entry>> slots_;
+    // Levels A1..Aα hold a tag group per bucket and β entries per bucket;
+    // the overflow A_{α+1} has one tag per slot.
+    std::vector<std::vector<TagGroup>> groups_;
+    std::vector<uint8_t> overflowTags_;
+    std::vector<std::vector<Entry>> entries_;  // all α+1 levels
     std::vector<size_t> occupied_;
+    std::vector<BlockedBloomFilter> filters_;  // one per level if Filtered
     size_t total_size_{}, inserts_done_{};
     double delta_{};
     size_t alpha_{}, beta_{};
+    // Geometry fixed by buildLevels, so operations need no division or
+    // floating point: the expansion threshold (1-δ)n, and the overflow's
+    // uniform half, probe limit ⌈log log n⌉ and two-choice buckets of
+    // 2·limit slots (ovBuckets_ is 0 when the half is too small for two).
+    size_t maxInserts_{};
+    size_t ovHalf_{}, ovLimit_{}, ovBucketSize_{}, ovBuckets_{};
 
     // build levels A1..Aα and overflow A_{α+1} (paper Sec.3)
     void buildLevels(size_t n) {
-        slots_.clear();
+        groups_.clear();
+        entries_.clear();
         occupied_.clear();
         size_t minOverflow = size_t(std::ceil(delta_ * n / 2));
         size_t rem = n - minOverflow;
@@ -187,111 +193,180 @@ class FunnelHash : public HashBase<K, V> {
         size_t overflowSz = n - assigned;
         if (overflowSz < minOverflow) overflowSz = minOverflow;
         sizes.push_back(overflowSz);
+        filters_.clear();
         for (size_t sz : sizes) {
-            slots_.emplace_back(sz);
+            if (groups_.size() < alpha_) groups_.emplace_back(sz / beta_);
+            entries_.emplace_back(sz);
             occupied_.push_back(0);
+            if constexpr (Filtered) filters_.emplace_back(sz);
+        }
+        overflowTags_.assign(overflowSz, EMPTY);
+
+        maxInserts_ = size_t(std::floor(total_size_ * (1 - delta_)));
+        ovHalf_ = overflowSz / 2;
+        ovLimit_ = size_t(std::ceil(std::log2(std::log2(total_size_ + 2))));
+        ovBucketSize_ = ovLimit_ * 2;
+        ovBuckets_ = ovHalf_ >= ovBucketSize_ * 2 ? ovHalf_ / ovBucketSize_ : 0;
+    }
+
+    // insert() once the key's hash is known; every level and the overflow
+    // probes derive their positions from h instead of rehashing the key.
+    void insertHashed(const K &key, const V &value, uint64_t h) {
+        // Expand if load exceeds (1-δ)
+        if (inserts_done_ >= maxInserts_) {
+            expand();
+            insertHashed(key, value, h);
+            return;
+        }
+        // Greedy tries on levels A1..Aα
+        for (size_t lvl = 0; lvl < alpha_; ++lvl) {
+            uint64_t lh = hashToBucket(lvl, h);
+            size_t b = fastrange(lh, groups_[lvl].size());
+            TagGroup &g = groups_[lvl][b];
+            uint8_t tag = tagOf(lh);
+            for (uint32_t m = matchTags(g, tag); m; m &= m - 1) {
+                Entry &e = entries_[lvl][b * beta_ + size_t(__builtin_ctz(m))];
+                if (e.key == key) {
+                    e.value = value;  // update existing
+                    return;
+                }
+            }
+            // first empty or deleted slot of the bucket
+            uint32_t free = matchTags(g, EMPTY) | matchTags(g, DELETED);
+            if (free) {
+                size_t j = size_t(__builtin_ctz(free));
+                g.tag[j] = tag;
+                place(lvl, b * beta_ + j, h, key, value);
+                ++inserts_done_;
+                return;
+            }
         }
+        // Overflow level A_{α+1}
+        // First half: uniform probing with up to O(log log n) attempts
+        insertOverflow(key, value, h);
     }
 
-    void insertOverflow(const K &key, const V &value) {
-        size_t m = slots_[alpha_].size();
-        size_t half = m / 2;
-        size_t limit = size_t(std::ceil(std::log2(std::log2(total_size_ + 2))));
+    std::optional<V> lookupHashed(const K &key, uint64_t h) const {
+        // search each level greedily (paper Sec.3)
+        for (size_t lvl = 0; lvl < alpha_; ++lvl) {
+            uint64_t lh = hashToBucket(lvl, h);
+            if constexpr (Filtered)
+                if (!filters_[lvl].mayContain(lh)) continue;
+            size_t b = fastrange(lh, groups_[lvl].size());
+            for (uint32_t m = matchTags(groups_[lvl][b], tagOf(lh)); m;
+                 m &= m - 1) {
+                const Entry &e =
+                    entries_[lvl][b * beta_ + size_t(__builtin_ctz(m))];
+                if (e.key == key) return e.value;
+            }
+        }
+        return lookupOverflow(key, h);
+    }
+
+    void insertOverflow(const K &key, const V &value, uint64_t h) {
+        uint8_t tag = tagOf(hashToBucket(alpha_, h));
         // uniform half
-        for (size_t t = 0; t < limit; ++t) {
-            size_t idx = hashPos(alpha_, key, t) % half;
-            Entry &e = slots_[alpha_][idx];
-            if (e.state == State::Occupied) {
-                if (e.kv->first == key) {
-                    e.kv->second = value;
+        for (size_t t = 0; t < ovLimit_; ++t) {
+            size_t idx = fastrange(hashPos(alpha_, h, t), ovHalf_);
+            if (overflowTags_[idx] > DELETED) {
+                if (overflowTags_[idx] == tag &&
+                    entries_[alpha_][idx].key == key) {
+                    entries_[alpha_][idx].value = value;
                     return;
                 }
                 continue;
             }
-            place(alpha_, idx, key, value);
+            overflowTags_[idx] = tag;
+            place(alpha_, idx, h, key, value);
             ++inserts_done_;
             return;
         }
         // two-choice or single-scan fallback
-        size_t bucket_size = limit * 2;
-        if (half >= bucket_size * 2) {
-            size_t nb2 = half / bucket_size;
-            size_t h1 = hashToBucket(alpha_, std::hash<K>{}(key)) % nb2;
-            size_t h2 = hashToBucket(alpha_, std::hash<K>{}(key) ^ 0x9e3779b97f4a7c15ULL) % nb2;
-            for (size_t j = 0; j < bucket_size; ++j) {
-                size_t i1 = half + h1 * bucket_size + j;
-                size_t i2 = half + h2 * bucket_size + j;
+        if (ovBuckets_) {
+            size_t b1 = ovBucketStart(hashToBucket(alpha_, h));
+            size_t b2 =
+                ovBucketStart(hashToBucket(alpha_, h ^ 0x9e3779b97f4a7c15ULL));
+            for (size_t j = 0; j < ovBucketSize_; ++j) {
+                size_t i1 = b1 + j;
+                size_t i2 = b2 + j;
                 for (size_t idx : {i1, i2}) {
-                    Entry &e = slots_[alpha_][idx];
-                    if (e.state == State::Occupied) {
-                        if (e.kv->first == key) {
-                            e.kv->second = value;
+                    if (overflowTags_[idx] > DELETED) {
+                        if (overflowTags_[idx] == tag &&
+                            entries_[alpha_][idx].key == key) {
+                            entries_[alpha_][idx].value = value;
                             return;
                         }
                         continue;
                     }
-                    place(alpha_, idx, key, value);
+                    overflowTags_[idx] = tag;
+                    place(alpha_, idx, h, key, value);
                     ++inserts_done_;
                     return;
                 }
             }
         } else {
             // scan entire second half
-            for (size_t idx = half; idx < m; ++idx) {
-                Entry &e = slots_[alpha_][idx];
-                if (e.state == State::Occupied) {
-                    if (e.kv->first == key) {
-                        e.kv->second = value;
+            for (size_t idx = ovHalf_; idx < overflowTags_.size(); ++idx) {
+                if (overflowTags_[idx] > DELETED) {
+                    if (overflowTags_[idx] == tag &&
+                        entries_[alpha_][idx].key == key) {
+                        entries_[alpha_][idx].value = value;
                         return;
                     }
                     continue;
                 }
-                place(alpha_, idx, key, value);
+                overflowTags_[idx] = tag;
+                place(alpha_, idx, h, key, value);
                 ++inserts_done_;
                 return;
             }
         }
         expand();
-        insert(key, value);
+        insertHashed(key, value, h);
     }
 
-    std::optional<V> lookupOverflow(const K &key) const {
-        size_t m = slots_[alpha_].size();
-        if (m < 1) return {};
-        size_t half = m / 2;
-        size_t limit = size_t(std::ceil(std::log2(std::log2(total_size_ + 2))));
+    std::optional<V> lookupOverflow(const K &key, uint64_t h) const {
+        size_t idx = findOverflow(key, h);
+        if (idx == NOT_FOUND) return {};
+        return entries_[alpha_][idx].value;
+    }
+
+    // Slot of key in the overflow level, or NOT_FOUND. Visits the same
+    // uniform probes and two-choice buckets that insertOverflow fills.
+    size_t findOverflow(const K &key, uint64_t h) const {
+        if (overflowTags_.empty()) return NOT_FOUND;
+        uint64_t lh = hashToBucket(alpha_, h);
+        if constexpr (Filtered)
+            if (!filters_[alpha_].mayContain(lh)) return NOT_FOUND;
+        uint8_t tag = tagOf(lh);
         // uniform half
-        for (size_t t = 0; t < limit; ++t) {
-            size_t idx = hashPos(alpha_, key, t) % half;
-            const Entry &e = slots_[alpha_][idx];
-            if (e.state == State::Empty) break;
-            if (e.state == State::Occupied && e.kv->first == key)
-                return e.kv->second;
+        for (size_t t = 0; t < ovLimit_; ++t) {
+            size_t idx = fastrange(hashPos(alpha_, h, t), ovHalf_);
+            if (overflowTags_[idx] == EMPTY) break;
+            if (overflowTags_[idx] == tag && entries_[alpha_][idx].key == key)
+                return idx;
         }
         // two-choice or single-scan fallback
-        size_t bucket_size = limit * 2;
-        if (half >= bucket_size * 2) {
-            size_t nb2 = half / bucket_size;
-            size_t h1 = hashToBucket(alpha_, std::hash<K>{}(key)) % nb2;
-            size_t h2 = hashToBucket(alpha_, std::hash<K>{}(key) ^ 0x9e3779b97f4a7c15ULL) % nb2;
-            for (size_t j = 0; j < bucket_size; ++j) {
-                for (size_t idx : {half + h1 * bucket_size + j,
-                                   half + h2 * bucket_size + j}) {
-                    const Entry &e = slots_[alpha_][idx];
-                    if (e.state == State::Empty) break;
-                    if (e.state == State::Occupied && e.kv->first == key)
-                        return e.kv->second;
+        if (ovBuckets_) {
+            size_t b1 = ovBucketStart(lh);
+            size_t b2 =
+                ovBucketStart(hashToBucket(alpha_, h ^ 0x9e3779b97f4a7c15ULL));
+            for (size_t j = 0; j < ovBucketSize_; ++j) {
+                for (size_t idx : {b1 + j, b2 + j}) {
+                    if (overflowTags_[idx] == EMPTY) break;
+                    if (overflowTags_[idx] == tag &&
+                        entries_[alpha_][idx].key == key)
+                        return idx;
                 }
             }
         } else {
-            for (size_t idx = half; idx < m; ++idx) {
-                const Entry &e = slots_[alpha_][idx];
-                if (e.state == State::Empty) continue;
-                if (e.state == State::Occupied && e.kv->first == key)
-                    return e.kv->second;
+            for (size_t idx = ovHalf_; idx < overflowTags_.size(); ++idx) {
+                if (overflowTags_[idx] == tag &&
+                    entries_[alpha_][idx].key == key)
+                    return idx;
             }
         }
-        return {};
+        return NOT_FOUND;
     }
 
     static uint64_t splitmix64(uint64_t x) {
@@ -301,8 +376,7 @@ class FunnelHash : public HashBase<K, V> {
         return x ^ (x >> 31);
     }
 
-    size_t hashPos(size_t lvl, const K &key, size_t probe) const {
-        uint64_t h = std::hash<K>{}(key);
+    size_t hashPos(size_t lvl, uint64_t h, size_t probe) const {
         uint64_t a = splitmix64(h ^ lvl);
         uint64_t b = splitmix64(h ^ probe);
         return size_t(splitmix64(a ^ b));
@@ -313,9 +387,47 @@ class FunnelHash : public HashBase<K, V> {
         return size_t(splitmix64(mix));
     }
 
-    void place(size_t lvl, size_t idx, const K &key, const V &val) {
-        slots_[lvl][idx].state = State::Occupied;
-        slots_[lvl][idx].kv = std::pair<K, V>(key, val);
+    // Maps a 64-bit hash onto [0, n) with a multiply instead of a modulo.
+    // Uses the high bits of h.
+    static size_t fastrange(uint64_t h, size_t n) {
+        return size_t((unsigned __int128)h * n >> 64);
+    }
+
+    size_t ovBucketStart(uint64_t lh) const {
+        return ovHalf_ + fastrange(lh, ovBuckets_) * ovBucketSize_;
+    }
+
+    // Fingerprint of a key in a level: a byte of its level hash that the
+    // bucket choice (the high bits) does not decide, kept clear of the
+    // EMPTY and DELETED values.
+    static uint8_t tagOf(uint64_t lh) {
+        uint8_t t = uint8_t(lh >> 32);
+        return t > DELETED ? t : uint8_t(t + 2);
+    }
+
+    // Bit j set for each of the first β tags of g equal to tag.
+    uint32_t matchTags(const TagGroup &g, uint8_t tag) const {
+#if defined(__SSE2__)
+        __m128i v = _mm_load_si128(reinterpret_cast<const __m128i *>(g.tag));
+        uint32_t m = uint32_t(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(char(tag)))));
+#else
+        uint32_t m = 0;
+        for (size_t j = 0; j < beta_; ++j) m |= uint32_t(g.tag[j] == tag) << j;
+#endif
+        return m & ((1u << beta_) - 1);
+    }
+
+    uint8_t tagAt(size_t lvl, size_t idx) const {
+        if (lvl == alpha_) return overflowTags_[idx];
+        return groups_[lvl][idx / beta_].tag[idx % beta_];
+    }
+
+    // Stores the entry; the caller has already set the slot's tag.
+    void place(size_t lvl, size_t idx, uint64_t h, const K &key,
+               const V &val) {
+        if constexpr (Filtered) filters_[lvl].add(hashToBucket(lvl, h));
+        entries_[lvl][idx] = {key, val};
         ++occupied_[lvl];
     }
 
@@ -323,9 +435,11 @@ class FunnelHash : public HashBase<K, V> {
         total_size_ *= 2;
         std::vector<std::pair<K, V>> items;
         items.reserve(inserts_done_);
-        for (auto &lvl : slots_)
-            for (auto &e : lvl)
-                if (e.state == State::Occupied) items.push_back(*e.kv);
+        for (size_t lvl = 0; lvl < entries_.size(); ++lvl)
+            for (size_t idx = 0; idx < entries_[lvl].size(); ++idx)
+                if (tagAt(lvl, idx) > DELETED)
+                    items.emplace_back(std::move(entries_[lvl][idx].key),
+                                       std::move(entries_[lvl][idx].value));
         buildLevels(total_size_);
         inserts_done_ = 0;
         for (auto &kv : items) insert(kv.first, kv.second);
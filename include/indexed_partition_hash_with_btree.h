@@ -1,37 +1,255 @@
 #pragma once
 
-#include <climits>
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdint>
 #include <functional>
+#include <iterator>
+#include <mutex>
 #include <optional>
-#include <random>
 #include <stdexcept>
-#include <unordered_map>
+#include <thread>
 #include <vector>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 #include "hash_base.h"
+#include "parallel_for.h"
 
 using namespace std;
 
+/**
+ * @brief Compact per-bucket query mapper.
+ *
+ * Maps a key hash to the key's position in its bucket's entry array. Slots
+ * are grouped by 16; each slot has a control byte holding a 7-bit
+ * fingerprint (or EMPTY/DELETED) and an entry position of type Pos. A
+ * query compares its fingerprint against a whole group with one SIMD
+ * compare and checks only the matching candidates against the entry array.
+ * The table is kept at most 7/8 full, so queries touch O(1) groups in
+ * expectation, and costs 1 + sizeof(Pos) bytes per slot instead of a heap
+ * node per key.
+ */
+template <typename Pos = uint16_t>
+class QueryMapper {
+   public:
+    static constexpr size_t GROUP = 16;
+    static constexpr size_t NOT_FOUND = SIZE_MAX;
+
+    /**
+     * @brief Drops all mappings and sizes the table for up to capacity keys.
+     *        A capacity of 0 releases the table entirely.
+     */
+    void reset(size_t capacity) {
+        if (capacity == 0) {
+            ctrl_.clear();
+            ctrl_.shrink_to_fit();
+            pos_.clear();
+            pos_.shrink_to_fit();
+            mask_ = used_ = tombstones_ = 0;
+            return;
+        }
+        size_t groups = 1;
+        while (groups * GROUP * 7 / 8 < capacity) groups *= 2;
+        ctrl_.assign(groups * GROUP, EMPTY);
+        pos_.assign(groups * GROUP, 0);
+        mask_ = groups - 1;
+        used_ = 0;
+        tombstones_ = 0;
+    }
+
+    /**
+     * @brief Finds the slot whose entry position satisfies isMatch.
+     * @param h Mixed hash of the key.
+     * @param isMatch Called with candidate entry positions whose
+     *                fingerprint matches.
+     * @return Slot index, or NOT_FOUND.
+     */
+    template <typename Match>
+    size_t find(uint64_t h, Match&& isMatch) const {
+        if (ctrl_.empty()) return NOT_FOUND;
+        uint8_t tag = tagOf(h);
+        size_t g = h & mask_;
+        for (size_t step = 1; step <= mask_ + 1; ++step) {
+            const uint8_t* group = &ctrl_[g * GROUP];
+            for (uint32_t bits = matchByte(group, tag); bits != 0;
+                 bits &= bits - 1) {
+                size_t slot = g * GROUP + __builtin_ctz(bits);
+                if (isMatch(pos_[slot])) return slot;
+            }
+            if (matchByte(group, EMPTY) != 0) return NOT_FOUND;
+            g = (g + step) & mask_;
+        }
+        return NOT_FOUND;
+    }
+
+    /**
+     * @brief Maps a key that is known to be absent to an entry position.
+     * @return false if the table is unallocated or has run out of free
+     *         slots and must be rebuilt with reset() first.
+     */
+    bool insert(uint64_t h, Pos pos) {
+        if ((used_ + tombstones_ + 1) * 8 > ctrl_.size() * 7) return false;
+        size_t g = h & mask_;
+        for (size_t step = 1;; ++step) {
+            const uint8_t* group = &ctrl_[g * GROUP];
+            uint32_t free = matchByte(group, EMPTY) | matchByte(group, DELETED);
+            if (free != 0) {
+                size_t slot = g * GROUP + __builtin_ctz(free);
+                if (ctrl_[slot] == DELETED) --tombstones_;
+                ctrl_[slot] = tagOf(h);
+                pos_[slot] = pos;
+                ++used_;
+                return true;
+            }
+            g = (g + step) & mask_;
+        }
+    }
+
+    /**
+     * @brief Removes the mapping stored in slot.
+     */
+    void erase(size_t slot) {
+        ctrl_[slot] = DELETED;
+        --used_;
+        ++tombstones_;
+    }
+
+    /**
+     * @brief Returns the entry position stored in slot.
+     */
+    Pos position(size_t slot) const { return pos_[slot]; }
+
+    /**
+     * @brief Changes the entry position stored in slot.
+     */
+    void setPosition(size_t slot, Pos pos) { pos_[slot] = pos; }
+
+    /**
+     * @brief Returns the number of bytes used by the mapper.
+     */
+    size_t bytes() const {
+        return ctrl_.size() * (sizeof(uint8_t) + sizeof(Pos));
+    }
+
+   private:
+    static constexpr uint8_t EMPTY = 0x80;
+    static constexpr uint8_t DELETED = 0xFE;
+
+    std::vector<uint8_t> ctrl_;
+    std::vector<Pos> pos_;
+    size_t mask_ = 0;
+    size_t used_ = 0;
+    size_t tombstones_ = 0;
+
+    // Top 7 bits of the hash; the low bits pick the group.
+    static uint8_t tagOf(uint64_t h) { return uint8_t(h >> 57); }
+
+    // Bitmask of the bytes in a 16-byte group that equal b.
+    static uint32_t matchByte(const uint8_t* group, uint8_t b) {
+#ifdef __SSE2__
+        __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return uint32_t(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(char(b)))));
+#else
+        uint32_t bits = 0;
+        for (size_t i = 0; i < GROUP; ++i)
+            if (group[i] == b) bits |= uint32_t(1) << i;
+        return bits;
+#endif
+    }
+};
+
+/**
+ * @brief A one-byte test-and-test-and-set spinlock for short critical
+ *        sections.
+ *
+ * Waiters spin briefly and then yield, so oversubscribed threads do not
+ * burn the holder's time slice.
+ *
+ * Copying or moving yields a fresh, unlocked lock, so structures holding one
+ * can still be stored in a std::vector; this is only done while no other
+ * thread holds the lock.
+ */
+class SpinLock {
+   public:
+    SpinLock() = default;
+    SpinLock(const SpinLock&) {}
+    SpinLock& operator=(const SpinLock&) { return *this; }
+
+    void lock() {
+        while (locked_.exchange(true, std::memory_order_acquire)) {
+            for (size_t spins = 0; locked_.load(std::memory_order_relaxed);
+                 ++spins) {
+                if (spins < MAX_SPINS)
+                    pause();
+                else
+                    std::this_thread::yield();
+            }
+        }
+    }
+
+    void unlock() { locked_.store(false, std::memory_order_release); }
+
+   private:
+    static constexpr size_t MAX_SPINS = 64;
+
+    std::atomic<bool> locked_{false};
+
+    static void pause() {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#endif
+    }
+};
+
+/**
+ * @brief A lock that does nothing, used when no synchronization is needed.
+ */
+struct NullLock {
+    void lock() {}
+    void unlock() {}
+};
+
 /**
  * @brief IndexedPartitionHashWithBTree implements a fixed-capacity hash table
  * with:
  * - Constant-time query/delete (worst case)
  * - Expected constant-time insertion
- * - Query mapper per bucket (implemented with B-tree over loglog(n)-bit keys)
+ * - Query mapper per bucket (a compact SIMD fingerprint table, see
+ *   QueryMapper)
+ *
+ * Bucket storage is allocated lazily: a bucket's entry array and mapper
+ * grow geometrically with its occupancy up to the bucket capacity and
+ * shrink again after deletes, so memory tracks the number of stored keys
+ * rather than n.
+ *
+ * Keys that arrive at a full bucket go to a shared backyard table instead
+ * of failing. Each bucket counts how many of its keys live in the backyard,
+ * so lookups probe at most one bucket mapper plus, only for buckets that
+ * have overflowed, the backyard mapper.
+ *
+ * With Concurrent = true every bucket and the backyard carry a SpinLock, and
+ * insert, lookup, update and remove may be called from any number of
+ * threads. An operation locks only its own bucket, plus the backyard when
+ * the bucket has overflowed or is full, always in that order. Concurrent
+ * tables do not grow automatically, so size n for the expected number of
+ * keys; rehash(), clear() and size() must not race with other operations.
  */
-template <typename K, typename V>
+template <typename K, typename V, bool Concurrent = false>
 class IndexedPartitionHashWithBTree : public HashBase<K, V> {
    public:
     using KeyType = K;
     using ValueType = V;
 
     explicit IndexedPartitionHashWithBTree(uint64_t n = 16, double c = 2.0)
-        : n_(n),
-          c_(c),
-          fingerprint_domain_(UINT32_MAX),
-          rng_(std::random_device{}()) {
+        : n_(n), c_(c) {
         init_structure();
     }
 
@@ -42,175 +260,366 @@ class IndexedPartitionHashWithBTree : public HashBase<K, V> {
         }
     }
 
+    /**
+     * @brief Redistributes all entries over a freshly sized structure.
+     *
+     * A parallel counting pass sizes every new bucket; the old entries are
+     * then moved straight into their new slots, each chunk of old buckets
+     * writing to its own precomputed ranges, and every new bucket's mapper is
+     * built by exactly one thread, so no locking is needed. Keys beyond a
+     * bucket's capacity are moved to the backyard afterwards.
+     */
     void rehash() {
-        std::vector<std::pair<K, V>> all_entries;
-        for (const auto& bucket : buckets_) {
-            for (uint64_t i = 0; i < bucket.count; ++i) {
-                all_entries.emplace_back(bucket.entries[i].key,
-                                         bucket.entries[i].value);
-            }
-        }
+        std::vector<Bucket> old_buckets;
+        old_buckets.swap(buckets_);
+        Backyard old_backyard = std::move(backyard_);
         init_structure();  // rebuild new structure with updated n_
-        for (const auto& [key, value] : all_entries) {
-            insert_no_resize(key,
-                             value);  // re-insert without triggering resize
-        }
-    }
 
-    // helper that inserts without checking resize
-    void insert_no_resize(const K& key, const V& value) {
-        uint64_t b = bucket_index(key);
-        Bucket& bucket = buckets_[b];
-
-        uint32_t fp = fingerprint(key, bucket.fingerprint_salt_);
-        if (bucket.query_mapper.count(fp)) {
-            rebuild_fingerprints(bucket);
-            fp = fingerprint(key, bucket.fingerprint_salt_);
+        // Old buckets plus the old backyard, as one list of sources.
+        std::vector<std::vector<Entry>*> sources;
+        sources.reserve(old_buckets.size() + 1);
+        for (auto& bucket : old_buckets) sources.push_back(&bucket.entries);
+        sources.push_back(&old_backyard.entries);
+        std::vector<size_t> old_start(sources.size() + 1, 0);
+        for (size_t s = 0; s < sources.size(); ++s)
+            old_start[s + 1] = old_start[s] + sources[s]->size();
+        size_t n = old_start.back();
+
+        // Hash every key once and count entries per (chunk, new bucket).
+        std::vector<uint64_t> hashes(n);
+        std::vector<std::vector<size_t>> cursor(
+            resolveThreadCount(rehash_threads_),
+            std::vector<size_t>(num_buckets_, 0));
+        auto for_sources = [&](auto&& body) {
+            return parallelFor(0, sources.size(), rehash_threads_, body,
+                               PARALLEL_MIN_BUCKETS);
+        };
+        size_t chunks = for_sources([&](size_t lo, size_t hi, size_t tid) {
+            for (size_t s = lo; s < hi; ++s) {
+                const std::vector<Entry>& from = *sources[s];
+                for (size_t i = 0; i < from.size(); ++i) {
+                    uint64_t h = hasher_(from[i].key);
+                    hashes[old_start[s] + i] = h;
+                    ++cursor[tid][bucket_index(h)];
+                }
+            }
+        });
+
+        // Turn the counts into per-chunk write cursors within each bucket.
+        // Positions past the bucket capacity map into a shared spill array.
+        std::vector<size_t> spill_start(num_buckets_ + 1, 0);
+        for (uint64_t b = 0; b < num_buckets_; ++b) {
+            size_t count = 0;
+            for (size_t c = 0; c < chunks; ++c) {
+                size_t k = cursor[c][b];
+                cursor[c][b] = count;
+                count += k;
+            }
+            buckets_[b].entries.resize(std::min<size_t>(count, bucket_capacity_));
+            spill_start[b + 1] =
+                spill_start[b] + (count - buckets_[b].entries.size());
         }
-
-        if (bucket.count >= bucket_capacity_) {
-            throw std::runtime_error("Bucket overflow during rehash");
+        std::vector<Entry> spill(spill_start[num_buckets_]);
+
+        // Move entries straight into their new buckets.
+        for_sources([&](size_t lo, size_t hi, size_t tid) {
+            for (size_t s = lo; s < hi; ++s) {
+                std::vector<Entry>& from = *sources[s];
+                for (size_t i = 0; i < from.size(); ++i) {
+                    uint64_t b = bucket_index(hashes[old_start[s] + i]);
+                    size_t at = cursor[tid][b]++;
+                    if (at < buckets_[b].entries.size())
+                        buckets_[b].entries[at] = std::move(from[i]);
+                    else
+                        spill[spill_start[b] + at - bucket_capacity_] =
+                            std::move(from[i]);
+                }
+                std::vector<Entry>().swap(from);
+            }
+        });
+        std::vector<uint64_t>().swap(hashes);
+
+        // Build every bucket's mapper, one thread per bucket.
+        parallelFor(
+            0, num_buckets_, rehash_threads_,
+            [&](size_t lo, size_t hi, size_t) {
+                for (size_t b = lo; b < hi; ++b) {
+                    Bucket& bucket = buckets_[b];
+                    bucket.query_mapper.reset(bucket.entries.size());
+                    for (size_t i = 0; i < bucket.entries.size(); ++i) {
+                        bucket.query_mapper.insert(
+                            mix(hasher_(bucket.entries[i].key)),
+                            static_cast<uint16_t>(i));
+                    }
+                }
+            },
+            PARALLEL_MIN_BUCKETS);
+
+        // Whatever did not fit goes to the backyard.
+        for (uint64_t b = 0; b < num_buckets_; ++b) {
+            for (size_t i = spill_start[b]; i < spill_start[b + 1]; ++i) {
+                append(backyard_, mix(hasher_(spill[i].key)), spill[i].key,
+                       spill[i].value, SIZE_MAX);
+                ++buckets_[b].overflow;
+            }
         }
-
-        uint64_t pos = bucket.count++;
-        bucket.entries[pos] = {key, value};
-        bucket.query_mapper[fp] = pos;
-        ++size_;
+        size_ = n;
     }
 
-    void insert(const K& key, const V& value) override {
-        maybe_resize();  // trigger resize if load factor >= 0.7
-
-        uint64_t b = bucket_index(key);
-        Bucket& bucket = buckets_[b];
+    /**
+     * @brief Sets the number of threads used by rehash() and automatic
+     *        growth.
+     * @param threads Worker threads, 0 means one per hardware thread.
+     */
+    void set_rehash_threads(size_t threads) { rehash_threads_ = threads; }
 
-        uint32_t fp = fingerprint(key, bucket.fingerprint_salt_);
-        if (bucket.query_mapper.count(fp)) {
-            rebuild_fingerprints(bucket);
-            fp = fingerprint(key, bucket.fingerprint_salt_);
+    void insert(const K& key, const V& value) override {
+        if constexpr (!Concurrent) {
+            maybe_resize();  // trigger resize if load factor >= 0.7
         }
 
-        if (bucket.count >= bucket_capacity_) {
-            throw std::runtime_error("Bucket overflow: rebuild required");
-        }
+        uint64_t h = hasher_(key);
+        Bucket& bucket = buckets_[bucket_index(h)];
+        uint64_t mh = mix(h);
+        std::lock_guard<Lock> guard(bucket.lock);
+        auto yard = lock_backyard(bucket);
 
-        uint64_t pos = bucket.count++;
-        bucket.entries[pos] = {key, value};
-        bucket.query_mapper[fp] = pos;
-        ++size_;
+        Entry* existing = find_entry(bucket, mh, key);
+        if (existing != nullptr) {
+            existing->value = value;
+            return;
+        }
+        place(bucket, mh, key, value);
     }
 
     std::optional<V> lookup(const K& key) const override {
-        uint64_t b = bucket_index(key);
-        const Bucket& bucket = buckets_[b];
-
-        uint32_t fp = fingerprint(key, bucket.fingerprint_salt_);
-        auto it = bucket.query_mapper.find(fp);
-        if (it == bucket.query_mapper.end()) return std::nullopt;
-
-        uint64_t pos = it->second;
-        if (pos >= bucket.count) return std::nullopt;
-        if (bucket.entries[pos].key != key) return std::nullopt;
-        return bucket.entries[pos].value;
+        uint64_t h = hasher_(key);
+        const Bucket& bucket = buckets_[bucket_index(h)];
+        std::lock_guard<Lock> guard(bucket.lock);
+        auto yard = lock_backyard(bucket);
+
+        const Entry* e = find_entry(bucket, mix(h), key);
+        if (e == nullptr) return std::nullopt;
+        return e->value;
     }
 
     bool update(const K& key, const V& value) override {
-        uint64_t b = bucket_index(key);
-        Bucket& bucket = buckets_[b];
-
-        uint32_t fp = fingerprint(key, bucket.fingerprint_salt_);
-        auto it = bucket.query_mapper.find(fp);
-        if (it == bucket.query_mapper.end()) return false;
-
-        uint64_t pos = it->second;
-        if (pos >= bucket.count || bucket.entries[pos].key != key) return false;
-        bucket.entries[pos].value = value;
+        uint64_t h = hasher_(key);
+        Bucket& bucket = buckets_[bucket_index(h)];
+        std::lock_guard<Lock> guard(bucket.lock);
+        auto yard = lock_backyard(bucket);
+
+        Entry* e = find_entry(bucket, mix(h), key);
+        if (e == nullptr) return false;
+        e->value = value;
         return true;
     }
 
     bool remove(const K& key) override {
-        uint64_t b = bucket_index(key);
-        Bucket& bucket = buckets_[b];
-
-        uint32_t fp = fingerprint(key, bucket.fingerprint_salt_);
-        auto it = bucket.query_mapper.find(fp);
-        if (it == bucket.query_mapper.end()) return false;
-
-        uint64_t pos = it->second;
-        if (pos >= bucket.count || bucket.entries[pos].key != key) return false;
-
-        // Swap with last item to maintain left justification
-        if (pos != bucket.count - 1) {
-            bucket.entries[pos] = bucket.entries[bucket.count - 1];
-            uint32_t moved_fp =
-                fingerprint(bucket.entries[pos].key, bucket.fingerprint_salt_);
-            bucket.query_mapper[moved_fp] = pos;
+        uint64_t h = hasher_(key);
+        Bucket& bucket = buckets_[bucket_index(h)];
+        uint64_t mh = mix(h);
+        std::lock_guard<Lock> guard(bucket.lock);
+        auto yard = lock_backyard(bucket);
+
+        size_t slot = find_slot(bucket, mh, key);
+        if (slot != QueryMapper<>::NOT_FOUND) {
+            erase_at(bucket, slot, bucket_capacity_);
+            count_removed();
+            return true;
         }
+        if (bucket.overflow == 0) return false;
 
-        bucket.query_mapper.erase(fp);
-        --bucket.count;
-        --size_;
+        slot = find_slot(backyard_, mh, key);
+        if (slot == QueryMapper<uint32_t>::NOT_FOUND) return false;
+        erase_at(backyard_, slot, SIZE_MAX);
+        --bucket.overflow;
+        count_removed();
         return true;
     }
 
-    uint64_t size() const override { return size_; }
+    uint64_t size() const override {
+        if constexpr (Concurrent) {
+            // Per-bucket counts avoid a shared counter on every update.
+            uint64_t total = 0;
+            for (const auto& bucket : buckets_)
+                total += bucket.entries.size() + bucket.overflow;
+            return total;
+        } else {
+            return size_;
+        }
+    }
 
     void clear() override { init_structure(); }
 
     double loadFactor() const override {
-        return static_cast<double>(size_) / static_cast<double>(n_);
+        return static_cast<double>(size()) / static_cast<double>(n_);
     }
 
     uint64_t capacity() const override { return n_; }
 
+    /**
+     * @brief Returns the number of keys currently held in the backyard.
+     */
+    uint64_t backyard_size() const { return backyard_.entries.size(); }
+
    private:
     struct Entry {
         K key;
         V value;
     };
 
-    struct Bucket {
-        std::vector<Entry> entries;
-        std::unordered_map<uint32_t, uint32_t> query_mapper;
-        uint64_t count = 0;
-        uint64_t fingerprint_salt_ = 42;
+    using Lock = std::conditional_t<Concurrent, SpinLock, NullLock>;
+
+    template <typename Pos>
+    struct Slots {
+        std::vector<Entry> entries;  // left-justified, size() is the count
+        QueryMapper<Pos> query_mapper;
+        uint32_t overflow = 0;  // keys of this bucket held in the backyard
+        mutable Lock lock;
     };
+    using Bucket = Slots<uint16_t>;
+    using Backyard = Slots<uint32_t>;
+
+    // Smallest allocation a non-empty bucket shrinks down to.
+    static constexpr size_t MIN_BUCKET_ALLOC = 16;
+
+    // Below this many buckets rehash() runs on the calling thread.
+    static constexpr size_t PARALLEL_MIN_BUCKETS = 64;
 
     uint64_t n_;
     double c_;
     uint64_t bucket_capacity_;
     uint64_t num_buckets_;
     std::vector<Bucket> buckets_;
+    Backyard backyard_;
     std::hash<K> hasher_;
     uint64_t size_;
-    uint32_t fingerprint_domain_;
-    std::mt19937_64 rng_;
+    size_t rehash_threads_ = 1;
+
+    uint64_t bucket_index(uint64_t h) const { return h % num_buckets_; }
 
-    uint64_t bucket_index(const K& key) const {
-        return hasher_(key) % num_buckets_;
+    // Rehashes h so the mapper's group and fingerprint bits are independent
+    // of the bucket index.
+    static uint64_t mix(uint64_t h) {
+        h += 0x9e3779b97f4a7c15ULL;
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        return h ^ (h >> 31);
     }
 
-    uint32_t fingerprint(const K& key, uint64_t fingerprint_salt_) const {
-        return (std::hash<K>()(key) ^ fingerprint_salt_) % fingerprint_domain_;
+    template <typename Pos>
+    size_t find_slot(const Slots<Pos>& slots, uint64_t mh, const K& key) const {
+        return slots.query_mapper.find(
+            mh, [&](Pos p) { return slots.entries[p].key == key; });
     }
 
-    void rebuild_fingerprints(Bucket& bucket) {
-        bucket.fingerprint_salt_ = rng_();
-        bucket.query_mapper.clear();
-        for (uint64_t i = 0; i < bucket.count; ++i) {
-            uint32_t new_fp =
-                fingerprint(bucket.entries[i].key, bucket.fingerprint_salt_);
-            if (bucket.query_mapper.count(new_fp)) {
-                // Retry recursively
-                rebuild_fingerprints(bucket);
-                return;
-            }
-            bucket.query_mapper[new_fp] = i;
+    // Finds a key in its bucket, then in the backyard if the bucket has
+    // overflowed.
+    const Entry* find_entry(const Bucket& bucket, uint64_t mh,
+                            const K& key) const {
+        size_t slot = find_slot(bucket, mh, key);
+        if (slot != QueryMapper<>::NOT_FOUND)
+            return &bucket.entries[bucket.query_mapper.position(slot)];
+        if (bucket.overflow == 0) return nullptr;
+        slot = find_slot(backyard_, mh, key);
+        if (slot == QueryMapper<uint32_t>::NOT_FOUND) return nullptr;
+        return &backyard_.entries[backyard_.query_mapper.position(slot)];
+    }
+
+    Entry* find_entry(Bucket& bucket, uint64_t mh, const K& key) {
+        return const_cast<Entry*>(
+            static_cast<const IndexedPartitionHashWithBTree*>(this)->find_entry(
+                bucket, mh, key));
+    }
+
+    // Locks the backyard if an operation on bucket may need it. The caller
+    // must hold the bucket's lock, so overflow and the bucket size are
+    // stable.
+    std::unique_lock<Lock> lock_backyard(const Bucket& bucket) const {
+        std::unique_lock<Lock> yard(backyard_.lock, std::defer_lock);
+        if (Concurrent && (bucket.overflow > 0 ||
+                           bucket.entries.size() >= bucket_capacity_))
+            yard.lock();
+        return yard;
+    }
+
+    void count_added() {
+        if constexpr (!Concurrent) ++size_;
+    }
+
+    void count_removed() {
+        if constexpr (!Concurrent) --size_;
+    }
+
+    // Stores a new key in its bucket, or in the backyard if the bucket is
+    // full.
+    void place(Bucket& bucket, uint64_t mh, const K& key, const V& value) {
+        if (bucket.entries.size() < bucket_capacity_) {
+            append(bucket, mh, key, value, bucket_capacity_);
+        } else {
+            append(backyard_, mh, key, value, SIZE_MAX);
+            ++bucket.overflow;
+        }
+        count_added();
+    }
+
+    template <typename Pos>
+    void append(Slots<Pos>& slots, uint64_t mh, const K& key, const V& value,
+                size_t limit) {
+        Pos pos = static_cast<Pos>(slots.entries.size());
+        // Grow geometrically but never past the limit, so a full bucket
+        // holds exactly bucket_capacity_ entries.
+        if (slots.entries.size() == slots.entries.capacity())
+            slots.entries.reserve(std::min<size_t>(
+                std::max<size_t>(4, 2 * slots.entries.size()), limit));
+        slots.entries.push_back({key, value});
+        if (!slots.query_mapper.insert(mh, pos)) {
+            // Out of room or too many tombstones; pos is re-added too.
+            rebuild_mapper(slots, slots.entries.size() * 2, limit);
+        }
+    }
+
+    template <typename Pos>
+    void erase_at(Slots<Pos>& slots, size_t slot, size_t limit) {
+        Pos pos = slots.query_mapper.position(slot);
+        slots.query_mapper.erase(slot);
+
+        // Swap with last item to maintain left justification
+        Pos last = static_cast<Pos>(slots.entries.size() - 1);
+        if (pos != last) {
+            slots.entries[pos] = std::move(slots.entries[last]);
+            size_t moved = slots.query_mapper.find(
+                mix(hasher_(slots.entries[pos].key)),
+                [&](Pos p) { return p == last; });
+            slots.query_mapper.setPosition(moved, pos);
+        }
+        slots.entries.pop_back();
+
+        // Give memory back once the bucket is a quarter full.
+        size_t count = slots.entries.size();
+        if (count * 4 <= slots.entries.capacity() &&
+            slots.entries.capacity() > MIN_BUCKET_ALLOC) {
+            std::vector<Entry>(std::make_move_iterator(slots.entries.begin()),
+                               std::make_move_iterator(slots.entries.end()))
+                .swap(slots.entries);
+            rebuild_mapper(slots, count * 2, limit);
         }
     }
 
-    // static constexpr uint64_t fingerprint_domain_ = 1ull << 12; // ~log^9(n)
-    // for n ~ 1M
+    // Rebuilds a mapper with room for the given number of keys, clamped to
+    // [count, limit].
+    template <typename Pos>
+    void rebuild_mapper(Slots<Pos>& slots, size_t room, size_t limit) {
+        room = std::max<size_t>(room, MIN_BUCKET_ALLOC);
+        room = std::min<size_t>(room, limit);
+        room = std::max<size_t>(room, slots.entries.size());
+        slots.query_mapper.reset(room);
+        for (size_t i = 0; i < slots.entries.size(); ++i) {
+            slots.query_mapper.insert(mix(hasher_(slots.entries[i].key)),
+                                      static_cast<Pos>(i));
+        }
+    }
 
     void init_structure() {
         size_ = 0;
@@ -219,16 +628,17 @@ class IndexedPartitionHashWithBTree : public HashBase<K, V> {
             static_cast<uint64_t>(std::pow(logn, 3) + c_ * std::pow(logn, 2));
         num_buckets_ = std::max<uint64_t>(
             1, static_cast<uint64_t>(n_ / std::pow(logn, 3)));
+        if (bucket_capacity_ > UINT16_MAX) {
+            throw std::length_error("Bucket capacity exceeds mapper range");
+        }
 
         // std::cout << "Bucket capacity: " << bucket_capacity_ << std::endl;
         // std::cout << "Number of buckets: " << num_buckets_ << std::endl;
 
+        // Buckets start unallocated and grow on demand.
         buckets_.clear();
+        buckets_.shrink_to_fit();
         buckets_.resize(num_buckets_);
-        for (auto& b : buckets_) {
-            b.entries.resize(bucket_capacity_);
-            b.count = 0;
-            b.query_mapper.clear();
-        }
+        backyard_ = Backyard();
     }
 };
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Returns the number of worker threads to use for a bulk operation.
+ * @param requested Requested thread count, 0 means one per hardware thread.
+ */
+inline size_t resolveThreadCount(size_t requested) {
+    if (requested > 0) return requested;
+    size_t hw = std::thread::hardware_concurrency();
+    return hw == 0 ? 1 : hw;
+}
+
+/**
+ * @brief Splits [begin, end) into contiguous chunks and runs body on each
+ *        chunk concurrently.
+ *
+ * body is called as body(lo, hi, tid) where tid is the chunk index in
+ * [0, threads). The calling thread runs the first chunk itself, and no
+ * threads are spawned when the range is smaller than minChunk.
+ *
+ * @param begin First index.
+ * @param end One past the last index.
+ * @param threads Number of chunks, 0 means one per hardware thread.
+ * @param body Callable invoked once per chunk.
+ * @param minChunk Minimum number of indices per chunk.
+ * @return Number of chunks actually used.
+ */
+template <typename F>
+size_t parallelFor(size_t begin, size_t end, size_t threads, F&& body,
+                   size_t minChunk = 1024) {
+    if (end <= begin) return 0;
+    size_t n = end - begin;
+    size_t t = std::min(resolveThreadCount(threads),
+                        std::max<size_t>(1, n / std::max<size_t>(1, minChunk)));
+    if (t <= 1) {
+        body(begin, end, size_t(0));
+        return 1;
+    }
+
+    size_t chunk = (n + t - 1) / t;
+    std::vector<std::thread> workers;
+    workers.reserve(t - 1);
+    for (size_t i = 1; i < t; ++i) {
+        size_t lo = begin + std::min(n, i * chunk);
+        size_t hi = begin + std::min(n, (i + 1) * chunk);
+        workers.emplace_back([&body, lo, hi, i] { body(lo, hi, i); });
+    }
+    body(begin, begin + std::min(n, chunk), size_t(0));
+    for (auto& w : workers) w.join();
+    return t;
+}
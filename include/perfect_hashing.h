@@ -1,11 +1,16 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <functional>
+#include <iterator>
 #include <optional>
+#include <stdexcept>
 #include <vector>
 
 #include "hash_base.h"
+#include "parallel_for.h"
 
 /**
  * @brief A secondary hash table used in two-level perfect hashing.
@@ -24,17 +29,31 @@ class SecondaryTable {
      * @param entries Key-value pairs to insert.
      */
     void build(const std::vector<std::pair<K, V>>& entries) {
-        size = entries.size();
-        capacity = std::max(2 * size * size, size_t(4));  // Ensure enough space
+        build(entries.begin(), entries.end());
+    }
+
+    /**
+     * @brief Builds the table from a range of key-value pairs. If a key
+     *        appears more than once, the last value wins.
+     * @param first Start of the range.
+     * @param last End of the range.
+     */
+    template <typename It>
+    void build(It first, It last) {
+        size_t n = static_cast<size_t>(std::distance(first, last));
+        capacity = std::max(2 * n * n, size_t(4));  // Ensure enough space
+        size = 0;
 
         table.clear();
         table.resize(capacity);
 
-        for (const auto& [k, v] : entries) {
+        for (; first != last; ++first) {
+            const auto& [k, v] = *first;
             size_t h = hash(k);
-            while (table[h].has_value()) {
+            while (table[h].has_value() && table[h]->first != k) {
                 h = (h + 1) % capacity;
             }
+            if (!table[h].has_value()) size++;
             table[h] = {k, v};
         }
     }
@@ -114,6 +133,30 @@ class SecondaryTable {
         return insert_or_modify(key, value);
     }
 
+    /**
+     * @brief Returns all stored key-value pairs.
+     */
+    std::vector<std::pair<K, V>> entries() const {
+        std::vector<std::pair<K, V>> out;
+        out.reserve(size);
+        for (const auto& slot : table) {
+            if (slot.has_value()) {
+                out.push_back(*slot);
+            }
+        }
+        return out;
+    }
+
+    /**
+     * @brief Returns the number of stored key-value pairs.
+     */
+    size_t count() const { return size; }
+
+    /**
+     * @brief Returns the number of allocated slots.
+     */
+    size_t slots() const { return capacity; }
+
    private:
     std::vector<std::optional<std::pair<K, V>>> table;
     size_t size = 0;
@@ -129,20 +172,23 @@ class SecondaryTable {
     /**
      * @brief Rebuilds the hash table to improve distribution.
      */
-    void rebuild() {
-        std::vector<std::pair<K, V>> entries;
-        for (const auto& slot : table) {
-            if (slot.has_value()) {
-                entries.push_back(*slot);
-            }
-        }
-        build(entries);
-    }
+    void rebuild() { build(entries()); }
 };
 
 /**
- * @brief A two-level perfect hash table using fixed-size top-level buckets
+ * @brief A two-level perfect hash table using growable top-level buckets
  *        and dynamically sized perfect secondary tables.
+ *
+ * Secondary tables take quadratic space in their bucket size, so the
+ * top-level array doubles whenever the load exceeds MAX_LOAD, the total
+ * secondary space exceeds SPACE_FACTOR slots per key, or a single bucket
+ * grows past MAX_BUCKET_SIZE. This keeps buckets small and total space
+ * linear in the number of keys.
+ *
+ * The table can be frozen into a compact layout in which all secondary
+ * tables share one contiguous slot array. Each bucket then stores only an
+ * offset, a capacity and a seed chosen so that its keys map to distinct
+ * slots, and a lookup touches one directory entry and one slot.
  */
 template <typename K, typename V>
 class PerfectHash : public HashBase<K, V> {
@@ -152,22 +198,78 @@ class PerfectHash : public HashBase<K, V> {
 
     /**
      * @brief Constructor.
-     * @param initialBuckets Number of top-level buckets.
+     * @param initialBuckets Initial number of top-level buckets.
      */
     explicit PerfectHash(size_t initialBuckets = 16)
-        : bucketCount(initialBuckets), size_(0) {
+        : bucketCount(std::max<size_t>(1, initialBuckets)), size_(0) {
         buckets.resize(bucketCount);
     }
 
+    /**
+     * @brief Bulk constructor, see build().
+     * @param entries Key-value pairs to load.
+     * @param threads Worker threads, 0 means one per hardware thread.
+     */
+    explicit PerfectHash(const std::vector<std::pair<K, V>>& entries,
+                         size_t threads = 0)
+        : bucketCount(1), size_(0), buildThreads_(threads) {
+        build(entries);
+    }
+
+    /**
+     * @brief Replaces the contents of the table with the given entries.
+     *
+     * Uses one top-level bucket per entry. Entries are partitioned by
+     * bucket and the secondary tables are built concurrently. If a key
+     * appears more than once, the last value wins.
+     * @param entries Key-value pairs to load.
+     */
+    void build(const std::vector<std::pair<K, V>>& entries) {
+        flatBuckets_.clear();
+        flatSlots_.clear();
+        frozen_ = false;
+        distribute(entries, std::max<size_t>(1, entries.size()));
+    }
+
+    /**
+     * @brief Sets the number of threads used by build(), resize(), freeze()
+     *        and automatic growth.
+     * @param threads Worker threads, 0 means one per hardware thread.
+     */
+    void setBuildThreads(size_t threads) { buildThreads_ = threads; }
+
     /**
      * @brief Inserts or updates a key-value pair.
+     *
+     * In frozen mode the key is placed in its slot if that slot is free;
+     * otherwise the table is thawed first.
      * @param key Key to insert.
      * @param value Value to insert.
      */
     void insert(const K& key, const V& value) override {
+        if (frozen_) {
+            auto* slot = flatSlot(key);
+            if (slot != nullptr) {
+                if (!slot->has_value()) {
+                    *slot = {key, value};
+                    ++size_;
+                    return;
+                }
+                if ((*slot)->first == key) {
+                    (*slot)->second = value;
+                    return;
+                }
+            }
+            thaw();
+        }
         size_t index = getBucketIndex(key);
-        if (buckets[index].insert_or_modify(key, value)) {
+        size_t before = buckets[index].count();
+        size_t slotsBefore = buckets[index].slots();
+        buckets[index].insert_or_modify(key, value);
+        totalSlots_ += buckets[index].slots() - slotsBefore;
+        if (buckets[index].count() > before) {
             ++size_;
+            maybeGrow(index);
         }
     }
 
@@ -177,6 +279,13 @@ class PerfectHash : public HashBase<K, V> {
      * @return std::nullopt if not found.
      */
     std::optional<V> lookup(const K& key) const override {
+        if (frozen_) {
+            const auto* slot = flatSlot(key);
+            if (slot == nullptr || !slot->has_value() ||
+                (*slot)->first != key)
+                return std::nullopt;
+            return (*slot)->second;
+        }
         size_t index = getBucketIndex(key);
         return buckets[index].lookup(key);
     }
@@ -187,6 +296,14 @@ class PerfectHash : public HashBase<K, V> {
      * @return true if the key was updated, false if not found.
      */
     bool update(const K& key, const V& value) override {
+        if (frozen_) {
+            auto* slot = flatSlot(key);
+            if (slot == nullptr || !slot->has_value() ||
+                (*slot)->first != key)
+                return false;
+            (*slot)->second = value;
+            return true;
+        }
         size_t index = getBucketIndex(key);
         auto existing = buckets[index].lookup(key);
         if (!existing.has_value()) return false;
@@ -199,6 +316,15 @@ class PerfectHash : public HashBase<K, V> {
      * @return true if successfully removed, false otherwise.
      */
     bool remove(const K& key) override {
+        if (frozen_) {
+            auto* slot = flatSlot(key);
+            if (slot == nullptr || !slot->has_value() ||
+                (*slot)->first != key)
+                return false;
+            slot->reset();
+            --size_;
+            return true;
+        }
         size_t index = getBucketIndex(key);
         if (buckets[index].remove(key)) {
             --size_;
@@ -213,13 +339,15 @@ class PerfectHash : public HashBase<K, V> {
     size_t size() const override { return size_; }
 
     /**
-     * @brief Clears all buckets.
+     * @brief Clears all buckets and leaves frozen mode.
      */
     void clear() override {
-        for (auto& b : buckets) {
-            b = SecondaryTable<K, V>();
-        }
+        flatBuckets_.clear();
+        flatSlots_.clear();
+        frozen_ = false;
+        buckets.assign(bucketCount, SecondaryTable<K, V>());
         size_ = 0;
+        totalSlots_ = 0;
     }
 
     /**
@@ -234,16 +362,337 @@ class PerfectHash : public HashBase<K, V> {
      */
     size_t capacity() const override { return bucketCount; }
 
+    /**
+     * @brief Packs all secondary tables into one contiguous slot array.
+     *
+     * Each bucket with s keys gets s * s slots and a seed under which its
+     * keys hash to distinct slots, so lookups need no probing. The dynamic
+     * secondary tables are released.
+     *
+     * Throws std::runtime_error and leaves the table unfrozen if a bucket
+     * finds no seed within MAX_SEED_ATTEMPTS, which happens when distinct
+     * keys share a hash value.
+     */
+    void freeze() {
+        if (frozen_) return;
+
+        flatBuckets_.assign(bucketCount, FlatBucket{});
+        size_t offset = 0;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            size_t count = buckets[i].count();
+            if (count > MAX_FROZEN_BUCKET)
+                throw std::length_error(
+                    "PerfectHash::freeze: bucket too large, use more buckets");
+            flatBuckets_[i].offset = offset;
+            flatBuckets_[i].capacity = static_cast<uint32_t>(count * count);
+            offset += count * count;
+        }
+        flatSlots_.clear();
+        flatSlots_.resize(offset);
+
+        // Buckets own disjoint slot ranges, so seeds are searched in parallel.
+        std::atomic<bool> failed{false};
+        parallelFor(0, bucketCount, buildThreads_,
+                    [&](size_t lo, size_t hi, size_t) {
+                        std::vector<size_t> positions;
+                        std::vector<bool> used;
+                        for (size_t i = lo; i < hi && !failed; ++i) {
+                            auto entries = buckets[i].entries();
+                            if (entries.empty()) continue;
+
+                            FlatBucket& fb = flatBuckets_[i];
+                            positions.resize(entries.size());
+                            bool ok = false;
+                            for (fb.seed = 0; fb.seed < MAX_SEED_ATTEMPTS;
+                                 ++fb.seed) {
+                                used.assign(fb.capacity, false);
+                                ok = true;
+                                for (size_t j = 0; j < entries.size() && ok;
+                                     ++j) {
+                                    positions[j] = flatPos(
+                                        hasher(entries[j].first), fb);
+                                    ok = !used[positions[j]];
+                                    used[positions[j]] = true;
+                                }
+                                if (ok) break;
+                            }
+                            if (!ok) {
+                                failed = true;
+                                break;
+                            }
+                            for (size_t j = 0; j < entries.size(); ++j)
+                                flatSlots_[fb.offset + positions[j]] =
+                                    std::move(entries[j]);
+                        }
+                    },
+                    PARALLEL_MIN_BUCKETS);
+
+        if (failed) {
+            flatBuckets_.clear();
+            flatSlots_.clear();
+            throw std::runtime_error(
+                "PerfectHash::freeze: keys with equal hashes in one bucket");
+        }
+
+        buckets.clear();
+        buckets.shrink_to_fit();
+        frozen_ = true;
+    }
+
+    /**
+     * @brief Leaves frozen mode, rebuilding the dynamic secondary tables.
+     */
+    void thaw() {
+        if (!frozen_) return;
+
+        buckets.assign(bucketCount, SecondaryTable<K, V>());
+        totalSlots_ = 0;
+        std::vector<std::pair<K, V>> entries;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            const FlatBucket& fb = flatBuckets_[i];
+            entries.clear();
+            for (size_t j = 0; j < fb.capacity; ++j) {
+                const auto& slot = flatSlots_[fb.offset + j];
+                if (slot.has_value()) entries.push_back(*slot);
+            }
+            if (entries.empty()) continue;
+            buckets[i].build(entries);
+            totalSlots_ += buckets[i].slots();
+        }
+
+        flatBuckets_.clear();
+        flatBuckets_.shrink_to_fit();
+        flatSlots_.clear();
+        flatSlots_.shrink_to_fit();
+        frozen_ = false;
+    }
+
+    /**
+     * @brief Returns true if the table is in the compact frozen layout.
+     */
+    bool frozen() const { return frozen_; }
+
+    /**
+     * @brief Returns the number of slots allocated across all secondary
+     *        tables.
+     */
+    size_t secondarySlots() const {
+        return frozen_ ? flatSlots_.size() : totalSlots_;
+    }
+
+    /**
+     * @brief Redistributes all entries over a new number of top-level
+     *        buckets.
+     * @param newBucketCount Number of top-level buckets to use.
+     */
+    void resize(size_t newBucketCount) {
+        thaw();
+
+        std::vector<std::pair<K, V>> all;
+        all.reserve(size_);
+        for (const auto& b : buckets) {
+            auto entries = b.entries();
+            std::move(entries.begin(), entries.end(), std::back_inserter(all));
+        }
+        distribute(all, std::max<size_t>(1, newBucketCount));
+    }
+
    private:
+    // Growth triggers, see class comment.
+    static constexpr double MAX_LOAD = 1.0;
+    static constexpr size_t SPACE_FACTOR = 8;
+    static constexpr size_t MAX_BUCKET_SIZE = 32;
+
+    // Minimum work per thread for parallel builds.
+    static constexpr size_t PARALLEL_MIN_ENTRIES = 1 << 16;
+    static constexpr size_t PARALLEL_MIN_BUCKETS = 1 << 14;
+
+    // Largest bucket whose s * s slots still fit a 32-bit capacity.
+    static constexpr size_t MAX_FROZEN_BUCKET = 65535;
+
+    // Seeds tried per bucket before freeze() gives up. A bucket of s keys
+    // in s * s slots succeeds with probability above 1/2 per seed, so only
+    // keys that no seed can separate exhaust this.
+    static constexpr uint32_t MAX_SEED_ATTEMPTS = 4096;
+
+    /**
+     * @brief Location of one bucket's slots in the frozen layout.
+     */
+    struct FlatBucket {
+        size_t offset = 0;
+        uint32_t capacity = 0;
+        uint32_t seed = 0;
+    };
+
     std::vector<SecondaryTable<K, V>> buckets;
     size_t bucketCount;
     size_t size_ = 0;
+    size_t totalSlots_ = 0;
+    size_t buildThreads_ = 1;
     std::hash<K> hasher;
 
+    bool frozen_ = false;
+    std::vector<FlatBucket> flatBuckets_;
+    std::vector<std::optional<std::pair<K, V>>> flatSlots_;
+
     /**
      * @brief Computes the index of the top-level bucket for a given key.
      * @param key Key to hash.
      * @return Index of the bucket.
      */
-    size_t getBucketIndex(K key) const { return hasher(key) % bucketCount; }
+    size_t getBucketIndex(K key) const { return bucketOfHash(hasher(key)); }
+
+    /**
+     * @brief Maps a key's hash onto a top-level bucket.
+     *
+     * The hash is mixed first: std::hash is the identity for integers and
+     * bucketCount is a power of two times the initial count, so reducing
+     * the raw hash would keep keys that share their low bits in one bucket
+     * however far the table grows.
+     */
+    size_t bucketOfHash(size_t h) const { return splitmix64(h) % bucketCount; }
+
+    /**
+     * @brief Rebuilds all secondary tables from the given entries over
+     *        newBucketCount top-level buckets.
+     *
+     * Entries are first scattered into one partition per thread, each
+     * covering a contiguous range of buckets. Every thread then groups its
+     * partition by bucket with a counting sort and builds those buckets'
+     * secondary tables, so no two threads touch the same bucket.
+     */
+    void distribute(const std::vector<std::pair<K, V>>& entries,
+                    size_t newBucketCount) {
+        bucketCount = newBucketCount;
+        buckets.assign(bucketCount, SecondaryTable<K, V>());
+        size_t n = entries.size();
+
+        size_t parts = std::min(resolveThreadCount(buildThreads_),
+                                std::max<size_t>(1, n / PARALLEL_MIN_ENTRIES));
+        parts = std::min(parts, bucketCount);
+        auto partOf = [&](size_t b) { return b * parts / bucketCount; };
+
+        // Count entries per (input chunk, partition).
+        std::vector<std::vector<size_t>> cursor(
+            parts, std::vector<size_t>(parts, 0));
+        size_t chunks = parallelFor(
+            0, n, parts,
+            [&](size_t lo, size_t hi, size_t tid) {
+                for (size_t i = lo; i < hi; ++i)
+                    ++cursor[tid][partOf(getBucketIndex(entries[i].first))];
+            },
+            PARALLEL_MIN_ENTRIES);
+
+        // Turn the counts into write cursors into the scattered array.
+        std::vector<size_t> partStart(parts + 1, 0);
+        size_t offset = 0;
+        for (size_t p = 0; p < parts; ++p) {
+            partStart[p] = offset;
+            for (size_t c = 0; c < chunks; ++c) {
+                size_t count = cursor[c][p];
+                cursor[c][p] = offset;
+                offset += count;
+            }
+        }
+        partStart[parts] = offset;
+
+        std::vector<std::pair<K, V>> scattered(n);
+        parallelFor(
+            0, n, parts,
+            [&](size_t lo, size_t hi, size_t tid) {
+                for (size_t i = lo; i < hi; ++i) {
+                    size_t p = partOf(getBucketIndex(entries[i].first));
+                    scattered[cursor[tid][p]++] = entries[i];
+                }
+            },
+            PARALLEL_MIN_ENTRIES);
+
+        std::vector<size_t> partSize(parts, 0), partSlots(parts, 0);
+        parallelFor(
+            0, parts, parts,
+            [&](size_t plo, size_t phi, size_t) {
+                for (size_t p = plo; p < phi; ++p) {
+                    size_t blo = (p * bucketCount + parts - 1) / parts;
+                    size_t bhi = ((p + 1) * bucketCount + parts - 1) / parts;
+
+                    std::vector<size_t> start(bhi - blo + 1, 0);
+                    for (size_t i = partStart[p]; i < partStart[p + 1]; ++i)
+                        ++start[getBucketIndex(scattered[i].first) - blo + 1];
+                    for (size_t b = 1; b < start.size(); ++b)
+                        start[b] += start[b - 1];
+
+                    std::vector<std::pair<K, V>> sorted(partStart[p + 1] -
+                                                        partStart[p]);
+                    std::vector<size_t> fill(start.begin(), start.end() - 1);
+                    for (size_t i = partStart[p]; i < partStart[p + 1]; ++i) {
+                        size_t b = getBucketIndex(scattered[i].first) - blo;
+                        sorted[fill[b]++] = std::move(scattered[i]);
+                    }
+
+                    for (size_t b = blo; b < bhi; ++b) {
+                        auto first = sorted.begin() + start[b - blo];
+                        auto last = sorted.begin() + start[b - blo + 1];
+                        if (first == last) continue;
+                        buckets[b].build(first, last);
+                        partSize[p] += buckets[b].count();
+                        partSlots[p] += buckets[b].slots();
+                    }
+                }
+            },
+            1);
+
+        size_ = 0;
+        totalSlots_ = 0;
+        for (size_t p = 0; p < parts; ++p) {
+            size_ += partSize[p];
+            totalSlots_ += partSlots[p];
+        }
+    }
+
+    /**
+     * @brief Doubles the top-level array if a growth trigger fired.
+     *
+     * The bucket-size trigger only applies while there are fewer buckets
+     * than keys, so keys that no top-level hash can separate cannot make
+     * the table grow without bound.
+     * @param index Bucket that just received a new key.
+     */
+    void maybeGrow(size_t index) {
+        bool overloaded = size_ > MAX_LOAD * bucketCount;
+        bool tooSparse = totalSlots_ > SPACE_FACTOR * size_ &&
+                         size_ * 2 > bucketCount;
+        bool bucketTooBig = buckets[index].count() > MAX_BUCKET_SIZE &&
+                            bucketCount < size_;
+        if (overloaded || tooSparse || bucketTooBig) resize(bucketCount * 2);
+    }
+
+    static uint64_t splitmix64(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    /**
+     * @brief Computes the slot of a hash inside a frozen bucket.
+     */
+    static size_t flatPos(size_t h, const FlatBucket& fb) {
+        return splitmix64(h ^ (uint64_t(fb.seed) << 32)) % fb.capacity;
+    }
+
+    /**
+     * @brief Returns the frozen slot for a key, or nullptr if its bucket is
+     *        empty.
+     */
+    const std::optional<std::pair<K, V>>* flatSlot(const K& key) const {
+        size_t h = hasher(key);
+        const FlatBucket& fb = flatBuckets_[bucketOfHash(h)];
+        if (fb.capacity == 0) return nullptr;
+        return &flatSlots_[fb.offset + flatPos(h, fb)];
+    }
+
+    std::optional<std::pair<K, V>>* flatSlot(const K& key) {
+        return const_cast<std::optional<std::pair<K, V>>*>(
+            static_cast<const PerfectHash*>(this)->flatSlot(key));
+    }
 };
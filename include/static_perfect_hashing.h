@@ -0,0 +1,282 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "parallel_for.h"
+
+/**
+ * @brief A BBHash-style minimal perfect hash function over a fixed key set.
+ *
+ * Keys are hashed into a bit array of gamma * |keys| bits per level. Keys
+ * that land alone in their bit keep it; colliding keys move on to the next,
+ * smaller level. The final index of a key is the rank of its bit over all
+ * levels, so the function maps n keys bijectively onto [0, n) using about
+ * e * gamma bits per key plus a small rank directory. Keys still colliding
+ * after MAX_LEVELS levels are kept in a small fallback map.
+ */
+template <typename K>
+class MinimalPerfectHash {
+   public:
+    MinimalPerfectHash() = default;
+
+    /**
+     * @brief Builds the function over the given keys.
+     * @param keys Distinct keys to index.
+     * @param gamma Bits per key on each level, >= 1. Larger is faster to
+     *              build and query but uses more space.
+     * @param threads Worker threads, 0 means one per hardware thread.
+     */
+    explicit MinimalPerfectHash(const std::vector<K>& keys, double gamma = 1.0,
+                                size_t threads = 0) {
+        build(keys, gamma, threads);
+    }
+
+    /**
+     * @brief (Re)builds the function over the given keys.
+     * @throws std::invalid_argument if keys contains duplicates.
+     */
+    void build(const std::vector<K>& keys, double gamma = 1.0,
+               size_t threads = 0) {
+        if (gamma < 1.0) gamma = 1.0;
+        n_ = keys.size();
+        bits_.clear();
+        ranks_.clear();
+        levelOffsets_.clear();
+        levelSizes_.clear();
+        fallback_.clear();
+
+        std::vector<uint64_t> remaining(n_);
+        parallelFor(0, n_, threads, [&](size_t lo, size_t hi, size_t) {
+            for (size_t i = lo; i < hi; ++i) remaining[i] = hashKey(keys[i]);
+        });
+
+        size_t maxThreads = resolveThreadCount(threads);
+        std::vector<std::vector<uint64_t>> next(maxThreads);
+        for (size_t lvl = 0; lvl < MAX_LEVELS && !remaining.empty(); ++lvl) {
+            size_t m = size_t(std::ceil(gamma * double(remaining.size())));
+            m = ((std::max<size_t>(m, 64) + 63) / 64) * 64;
+            size_t words = m / 64;
+
+            std::vector<std::atomic<uint64_t>> taken(words), collided(words);
+            parallelFor(0, remaining.size(), threads,
+                        [&](size_t lo, size_t hi, size_t) {
+                            for (size_t i = lo; i < hi; ++i) {
+                                size_t pos = levelPos(remaining[i], lvl, m);
+                                uint64_t bit = uint64_t(1) << (pos & 63);
+                                uint64_t prev = taken[pos >> 6].fetch_or(
+                                    bit, std::memory_order_relaxed);
+                                if (prev & bit)
+                                    collided[pos >> 6].fetch_or(
+                                        bit, std::memory_order_relaxed);
+                            }
+                        });
+
+            size_t used = parallelFor(
+                0, remaining.size(), threads,
+                [&](size_t lo, size_t hi, size_t tid) {
+                    next[tid].clear();
+                    for (size_t i = lo; i < hi; ++i) {
+                        size_t pos = levelPos(remaining[i], lvl, m);
+                        uint64_t bit = uint64_t(1) << (pos & 63);
+                        if (collided[pos >> 6].load(std::memory_order_relaxed) &
+                            bit)
+                            next[tid].push_back(remaining[i]);
+                    }
+                });
+
+            levelOffsets_.push_back(bits_.size() * 64);
+            levelSizes_.push_back(m);
+            size_t base = bits_.size();
+            bits_.resize(base + words);
+            for (size_t w = 0; w < words; ++w) {
+                bits_[base + w] = taken[w].load(std::memory_order_relaxed) &
+                                  ~collided[w].load(std::memory_order_relaxed);
+            }
+
+            remaining.clear();
+            for (size_t t = 0; t < used; ++t)
+                remaining.insert(remaining.end(), next[t].begin(),
+                                 next[t].end());
+        }
+
+        buildRanks();
+
+        size_t idx = n_ - remaining.size();
+        for (uint64_t h : remaining) {
+            if (!fallback_.emplace(h, idx++).second)
+                throw std::invalid_argument(
+                    "MinimalPerfectHash: duplicate keys in input");
+        }
+    }
+
+    /**
+     * @brief Returns the index of a key in [0, size()).
+     *
+     * For keys outside the build set the result is either size() or an
+     * arbitrary index; callers must verify membership themselves.
+     */
+    size_t operator()(const K& key) const {
+        uint64_t h = hashKey(key);
+        for (size_t lvl = 0; lvl < levelSizes_.size(); ++lvl) {
+            size_t pos =
+                levelOffsets_[lvl] + levelPos(h, lvl, levelSizes_[lvl]);
+            if (bits_[pos >> 6] & (uint64_t(1) << (pos & 63))) return rank(pos);
+        }
+        if (!fallback_.empty()) {
+            auto it = fallback_.find(h);
+            if (it != fallback_.end()) return it->second;
+        }
+        return n_;
+    }
+
+    /**
+     * @brief Returns the number of keys the function was built over.
+     */
+    size_t size() const { return n_; }
+
+    /**
+     * @brief Returns the number of bytes used by the function itself.
+     */
+    size_t sizeInBytes() const {
+        return (bits_.size() + ranks_.size()) * sizeof(uint64_t) +
+               (levelOffsets_.size() + levelSizes_.size()) * sizeof(size_t) +
+               fallback_.size() * (sizeof(uint64_t) + sizeof(size_t));
+    }
+
+    /**
+     * @brief Returns the space used per key, in bits.
+     */
+    double bitsPerKey() const {
+        return n_ == 0 ? 0.0 : 8.0 * double(sizeInBytes()) / double(n_);
+    }
+
+   private:
+    static constexpr size_t MAX_LEVELS = 32;
+    // One cumulative rank entry per 8 words (512 bits).
+    static constexpr size_t RANK_BLOCK_WORDS = 8;
+
+    std::vector<uint64_t> bits_;
+    std::vector<uint64_t> ranks_;
+    std::vector<size_t> levelOffsets_;
+    std::vector<size_t> levelSizes_;
+    std::unordered_map<uint64_t, size_t> fallback_;
+    size_t n_ = 0;
+
+    static uint64_t splitmix64(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    static uint64_t hashKey(const K& key) {
+        return splitmix64(std::hash<K>{}(key));
+    }
+
+    static size_t levelPos(uint64_t h, size_t lvl, size_t m) {
+        // Maps the mixed hash onto [0, m) with a multiply-shift instead of %.
+        uint64_t x =
+            splitmix64(h ^ (uint64_t(lvl + 1) * 0xc2b2ae3d27d4eb4fULL));
+        return size_t((static_cast<__uint128_t>(x) * m) >> 64);
+    }
+
+    void buildRanks() {
+        size_t blocks =
+            (bits_.size() + RANK_BLOCK_WORDS - 1) / RANK_BLOCK_WORDS;
+        ranks_.assign(blocks + 1, 0);
+        uint64_t total = 0;
+        for (size_t b = 0; b < blocks; ++b) {
+            ranks_[b] = total;
+            size_t end = std::min(bits_.size(), (b + 1) * RANK_BLOCK_WORDS);
+            for (size_t w = b * RANK_BLOCK_WORDS; w < end; ++w)
+                total += __builtin_popcountll(bits_[w]);
+        }
+        ranks_[blocks] = total;
+    }
+
+    size_t rank(size_t pos) const {
+        size_t word = pos >> 6;
+        size_t block = word / RANK_BLOCK_WORDS;
+        uint64_t r = ranks_[block];
+        for (size_t w = block * RANK_BLOCK_WORDS; w < word; ++w)
+            r += __builtin_popcountll(bits_[w]);
+        uint64_t mask = (uint64_t(1) << (pos & 63)) - 1;
+        return size_t(r + __builtin_popcountll(bits_[word] & mask));
+    }
+};
+
+/**
+ * @brief An immutable key-value map over a fixed key set.
+ *
+ * Entries are stored in one dense array indexed by a MinimalPerfectHash, so
+ * a lookup is one MPHF evaluation plus a single access to the entry array.
+ * Intended for tables that are built offline and then only queried.
+ */
+template <typename K, typename V>
+class StaticPerfectHash {
+   public:
+    using KeyType = K;
+    using ValueType = V;
+
+    StaticPerfectHash() = default;
+
+    /**
+     * @brief Builds the map from the given entries.
+     * @param entries Key-value pairs with distinct keys.
+     * @param gamma Bits per key per MPHF level, see MinimalPerfectHash.
+     * @param threads Worker threads, 0 means one per hardware thread.
+     * @throws std::invalid_argument if entries contains duplicate keys.
+     */
+    explicit StaticPerfectHash(const std::vector<std::pair<K, V>>& entries,
+                               double gamma = 1.0, size_t threads = 0) {
+        std::vector<K> keys(entries.size());
+        parallelFor(0, entries.size(), threads,
+                    [&](size_t lo, size_t hi, size_t) {
+                        for (size_t i = lo; i < hi; ++i)
+                            keys[i] = entries[i].first;
+                    });
+        mphf_.build(keys, gamma, threads);
+
+        table_.resize(entries.size());
+        parallelFor(0, entries.size(), threads,
+                    [&](size_t lo, size_t hi, size_t) {
+                        for (size_t i = lo; i < hi; ++i)
+                            table_[mphf_(entries[i].first)] = entries[i];
+                    });
+    }
+
+    /**
+     * @brief Retrieves the value for a given key.
+     * @param key Key to look up.
+     * @return std::nullopt if not found.
+     */
+    std::optional<V> lookup(const K& key) const {
+        size_t idx = mphf_(key);
+        if (idx >= table_.size() || !(table_[idx].first == key))
+            return std::nullopt;
+        return table_[idx].second;
+    }
+
+    /**
+     * @brief Returns the number of stored elements.
+     */
+    size_t size() const { return table_.size(); }
+
+    /**
+     * @brief Returns the space used by the MPHF alone, in bits per key.
+     */
+    double mphfBitsPerKey() const { return mphf_.bitsPerKey(); }
+
+   private:
+    MinimalPerfectHash<K> mphf_;
+    std::vector<std::pair<K, V>> table_;
+};
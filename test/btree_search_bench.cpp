@@ -0,0 +1,110 @@
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "btree.h"
+
+using namespace std::chrono;
+
+// Same order as std::less, but not std::less, so nodes are scanned one key
+// at a time.
+template <typename Key>
+struct ScalarLess {
+    bool operator()(const Key& a, const Key& b) const { return a < b; }
+};
+
+template <typename Key, int Order, typename Compare>
+double time_lookups(const std::vector<Key>& keys,
+                    const std::vector<Key>& probes) {
+    BTree<Key, Key, Order, Compare> t;
+    for (Key k : keys) t.insert(k, k);
+
+    uint64_t found = 0;
+    auto start = high_resolution_clock::now();
+    for (Key k : probes) found += t.contains(k);
+    auto end = high_resolution_clock::now();
+    if (found != probes.size()) std::cerr << "lookup mismatch\n";
+    return duration_cast<microseconds>(end - start).count() / 1000.0;
+}
+
+template <typename Key, int Order>
+void bench_order(const std::vector<Key>& keys, const std::vector<Key>& probes) {
+    double scalar = time_lookups<Key, Order, ScalarLess<Key>>(keys, probes);
+    double simd = time_lookups<Key, Order, std::less<Key>>(keys, probes);
+    std::cout << "  order " << Order << ": scalar " << scalar << " ms, simd "
+              << simd << " ms\n";
+}
+
+// Looks up LOOKUPS random stored keys in a tree of count keys. Small trees
+// stay in cache, so node search dominates; large ones are bound by misses.
+template <typename Key>
+void bench(const char* name, size_t count) {
+    constexpr size_t LOOKUPS = 2000000;
+    std::mt19937_64 rng(42);
+    std::vector<Key> keys(count);
+    for (Key& k : keys) k = static_cast<Key>(rng());
+    std::vector<Key> probes(LOOKUPS);
+    for (Key& k : probes) k = keys[rng() % count];
+
+    std::cout << "[" << name << ", " << count << " keys, "
+              << probes.size() << " lookups]\n";
+    bench_order<Key, 8>(keys, probes);
+    bench_order<Key, 16>(keys, probes);
+    bench_order<Key, 32>(keys, probes);
+    bench_order<Key, 64>(keys, probes);
+    std::cout << "  default order " << btreeDefaultOrder<Key>() << "\n";
+}
+
+// Insert, look up, traverse and remove count random keys in a tree of
+// small order, so every operation walks many levels.
+template <int Order>
+void bench_deep(size_t count) {
+    std::mt19937_64 rng(7);
+    std::vector<uint64_t> keys(count);
+    for (uint64_t& k : keys) k = rng();
+
+    BTree<uint64_t, uint64_t, Order> t;
+    auto time = [](auto&& body) {
+        auto start = high_resolution_clock::now();
+        body();
+        auto end = high_resolution_clock::now();
+        return duration_cast<microseconds>(end - start).count() / 1000.0;
+    };
+    double insert = time([&] {
+        for (uint64_t k : keys) t.insert(k, k);
+    });
+    std::shuffle(keys.begin(), keys.end(), rng);
+    uint64_t found = 0;
+    double lookup = time([&] {
+        for (uint64_t k : keys) found += t.contains(k);
+    });
+    uint64_t sum = 0;
+    double traverse = time([&] {
+        t.traverse([&](uint64_t, uint64_t v) { sum += v; });
+    });
+    int height = t.height();
+    double remove = time([&] {
+        for (uint64_t k : keys) t.remove(k);
+    });
+    if (found != count || t.size() != 0) std::cerr << "deep tree mismatch\n";
+
+    std::cout << "[deep tree, order " << Order << ", " << count
+              << " keys, height " << height << "]\n"
+              << "  insert " << insert << " ms, lookup " << lookup
+              << " ms, traverse " << traverse << " ms, remove " << remove
+              << " ms\n";
+}
+
+int main() {
+    bench<uint32_t>("uint32_t", 10000);
+    bench<uint32_t>("uint32_t", 1000000);
+    bench<uint64_t>("uint64_t", 10000);
+    bench<uint64_t>("uint64_t", 1000000);
+    bench_deep<4>(1000000);
+    bench_deep<8>(1000000);
+    return 0;
+}
@@ -172,6 +172,32 @@ void test_randomized_operations() {
     std::cout << "test_randomized_operations passed\n";
 }
 
+void test_churn_bounded() {
+    ElasticHash<uint64_t, uint64_t> table(1024);
+    const uint64_t N = 5000;
+    for (uint64_t k = 0; k < N; ++k) table.insert(k, k);
+    size_t cap = table.capacity();
+
+    // Rolling window: every round deletes the oldest keys and inserts as
+    // many new ones, so the live set never grows.
+    uint64_t lo = 0, hi = N;
+    for (int round = 0; round < 200; ++round) {
+        for (int i = 0; i < 500; ++i) assert(table.remove(lo++));
+        for (int i = 0; i < 500; ++i, ++hi) table.insert(hi, hi);
+        assert(table.size() == N);
+        assert(table.tombstones() <= table.capacity() / 4);
+    }
+    assert(table.capacity() == cap);
+
+    for (uint64_t k = 0; k < hi; ++k) {
+        auto v = table.lookup(k);
+        assert(v.has_value() == (k >= lo));
+        if (v) assert(v.value() == k);
+    }
+
+    std::cout << "test_churn_bounded passed\n";
+}
+
 
 int main() {
     test_insert_and_lookup();
@@ -180,6 +206,7 @@ int main() {
     test_bulk_sequential();
     test_remove_evens();
     test_randomized_operations();
+    test_churn_bounded();
     std::cout << "All ElasticHash stress tests passed successfully.\n";
     return 0;
 }
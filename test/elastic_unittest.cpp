@@ -102,12 +102,65 @@ void test_collisions() {
     std::cout << "test_collisions passed\n";
 }
 
+void test_filtered() {
+    ElasticHash<int, int, true> table(16);
+    for (int i = 0; i < 20000; ++i) table.insert(i, i + 1);
+    for (int i = 0; i < 20000; i += 3) assert(table.remove(i));
+    for (int i = 0; i < 20000; ++i) {
+        auto val = table.lookup(i);
+        assert(val.has_value() == (i % 3 != 0));
+        if (val) assert(val.value() == i + 1);
+    }
+    for (int i = 20000; i < 40000; ++i) assert(!table.lookup(i).has_value());
+    assert(table.update(1, 7) && table.lookup(1).value() == 7);
+    assert(!table.update(3, 7));
+
+    assert(table.filterBytes() > 0);
+    assert((ElasticHash<int, int>().filterBytes() == 0));
+
+    table.clear();
+    assert(!table.lookup(1).has_value());
+    table.insert(1, 2);
+    assert(table.lookup(1).value() == 2);
+
+    std::cout << "test_filtered passed\n";
+}
+
+void test_add_level_growth() {
+    using Table = ElasticHash<int, int>;
+    Table table(16, 0.1, Table::Growth::AddLevel);
+    for (int i = 0; i < 20000; ++i) table.insert(i, i * 2);
+    assert(table.capacity() == 32768);
+    for (int i = 0; i < 20000; i += 2) assert(table.remove(i));
+    for (int i = 0; i < 20000; ++i) {
+        auto val = table.lookup(i);
+        assert(val.has_value() == (i % 2 == 1));
+        if (val) assert(val.value() == i * 2);
+    }
+    assert(table.size() == 10000);
+
+    // Grow again on top of the levels the tombstone rebuild laid out.
+    for (int i = 20000; i < 60000; ++i) table.insert(i, i * 2);
+    assert(table.capacity() == 65536);
+    for (int i = 1; i < 60000; i += 2)
+        assert(table.lookup(i).value() == i * 2);
+
+    table.clear();
+    assert(table.size() == 0 && !table.lookup(1).has_value());
+    table.insert(1, 3);
+    assert(table.lookup(1).value() == 3);
+
+    std::cout << "test_add_level_growth passed\n";
+}
+
 int main() {
     test_insert_and_lookup();
     test_delete();
     test_update();
     test_resize();
     test_collisions();
+    test_filtered();
+    test_add_level_growth();
 
     std::cout << "All ElasticHash tests passed successfully.\n";
     return 0;
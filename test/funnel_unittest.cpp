@@ -102,12 +102,66 @@ void test_collisions() {
     std::cout << "test_collisions passed\n";
 }
 
+void test_filtered() {
+    FunnelHash<int, int, true> table(16);
+    for (int i = 0; i < 20000; ++i) table.insert(i, i + 1);
+    for (int i = 0; i < 20000; i += 3) assert(table.remove(i));
+    for (int i = 0; i < 20000; ++i) {
+        auto val = table.lookup(i);
+        assert(val.has_value() == (i % 3 != 0));
+        if (val) assert(val.value() == i + 1);
+    }
+    for (int i = 20000; i < 40000; ++i) assert(!table.lookup(i).has_value());
+    assert(table.update(1, 7) && table.lookup(1).value() == 7);
+    assert(!table.update(3, 7));
+
+    assert(table.filterBytes() > 0);
+    assert((FunnelHash<int, int>().filterBytes() == 0));
+
+    table.clear();
+    assert(!table.lookup(1).has_value());
+    table.insert(1, 2);
+    assert(table.lookup(1).value() == 2);
+
+    std::cout << "test_filtered passed\n";
+}
+
+// Two hash values for all keys, so levels fill up and keys spill into the
+// overflow level.
+struct WeakKey {
+    int v;
+    bool operator==(const WeakKey &o) const { return v == o.v; }
+};
+template <>
+struct std::hash<WeakKey> {
+    size_t operator()(const WeakKey &k) const { return size_t(k.v % 2); }
+};
+
+void test_overflow_remove() {
+    FunnelHash<WeakKey, int> table(1000);
+    for (int i = 0; i < 100; ++i) table.insert({i}, i);
+    assert(table.capacity() == 1000);
+    for (int i = 100; i < 200; ++i) assert(!table.remove({i}));
+    for (int i = 0; i < 100; i += 3) assert(table.remove({i}));
+    for (int i = 0; i < 100; ++i) {
+        auto val = table.lookup({i});
+        assert(val.has_value() == (i % 3 != 0));
+        if (val) assert(val.value() == i);
+    }
+    for (int i = 0; i < 100; ++i) assert(table.remove({i}) == (i % 3 != 0));
+    assert(!table.lookup({1}).has_value());
+
+    std::cout << "test_overflow_remove passed\n";
+}
+
 int main() {
     test_insert_and_lookup();
     test_delete();
     test_update();
     test_resize();
     test_collisions();
+    test_filtered();
+    test_overflow_remove();
 
     std::cout << "All FunnelHash tests passed successfully.\n";
     return 0;
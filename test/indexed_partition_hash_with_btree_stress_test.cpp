@@ -0,0 +1,109 @@
+// indexed_partition_hash_with_btree_stress_test.cpp
+#include "indexed_partition_hash_with_btree.h"
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// A key whose hash takes only a handful of distinct values, so every key
+// lands in one of a few buckets regardless of table size.
+struct SkewedKey {
+    uint64_t v;
+    bool operator==(const SkewedKey& o) const { return v == o.v; }
+};
+
+namespace std {
+template <>
+struct hash<SkewedKey> {
+    size_t operator()(const SkewedKey& k) const { return k.v % 3; }
+};
+}  // namespace std
+
+void test_skewed_inserts() {
+    IndexedPartitionHashWithBTree<SkewedKey, uint64_t> table(1 << 12);
+    const uint64_t N = 20000;
+
+    for (uint64_t i = 0; i < N; ++i) table.insert({i}, i * 2);
+    assert(table.size() == N);
+    assert(table.backyard_size() > 0);
+
+    for (uint64_t i = 0; i < N; ++i) {
+        auto v = table.lookup({i});
+        assert(v.has_value() && v.value() == i * 2);
+    }
+    assert(!table.lookup({N}).has_value());
+
+    std::cout << "test_skewed_inserts passed\n";
+}
+
+void test_skewed_random_ops() {
+    IndexedPartitionHashWithBTree<SkewedKey, uint64_t> table(1 << 10);
+    std::unordered_map<uint64_t, uint64_t> ref;
+    std::mt19937_64 rng(7);
+
+    for (int step = 0; step < 200000; ++step) {
+        uint64_t k = rng() % 8000;
+        switch (rng() % 4) {
+            case 0:
+            case 1:
+                table.insert({k}, step);
+                ref[k] = step;
+                break;
+            case 2:
+                assert(table.remove({k}) == (ref.erase(k) == 1));
+                break;
+            default: {
+                auto v = table.lookup({k});
+                auto it = ref.find(k);
+                assert(v.has_value() == (it != ref.end()));
+                if (v) assert(v.value() == it->second);
+            }
+        }
+        assert(table.size() == ref.size());
+    }
+
+    for (const auto& [k, v] : ref) assert(table.lookup({k}).value() == v);
+    for (const auto& [k, v] : ref) assert(table.remove({k}));
+    assert(table.size() == 0 && table.backyard_size() == 0);
+
+    std::cout << "test_skewed_random_ops passed\n";
+}
+
+void test_skewed_concurrent() {
+    const uint64_t THREADS = 4, PER_THREAD = 5000;
+    IndexedPartitionHashWithBTree<SkewedKey, uint64_t, true> table(1 << 12);
+
+    // All keys share three buckets, so most of them race on the backyard.
+    std::vector<std::thread> workers;
+    for (uint64_t t = 0; t < THREADS; ++t) {
+        workers.emplace_back([&table, t] {
+            std::mt19937_64 rng(t);
+            for (uint64_t i = 0; i < PER_THREAD; ++i) {
+                uint64_t k = i * THREADS + t;
+                table.insert({k}, k);
+                assert(table.lookup({k}).value() == k);
+                uint64_t old = (rng() % (i + 1)) * THREADS + t;
+                if (rng() % 2 && table.remove({old}))
+                    table.insert({old}, old);
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+
+    assert(table.size() == THREADS * PER_THREAD);
+    for (uint64_t k = 0; k < THREADS * PER_THREAD; ++k)
+        assert(table.lookup({k}).value() == k);
+
+    std::cout << "test_skewed_concurrent passed\n";
+}
+
+int main() {
+    test_skewed_inserts();
+    test_skewed_random_ops();
+    test_skewed_concurrent();
+
+    std::cout << "All stress tests passed for IndexedPartitionHashWithBTree.\n";
+    return 0;
+}
@@ -2,6 +2,7 @@
 #include "perfect_hashing.h"
 #include <iostream>
 #include <cassert>
+#include <stdexcept>
 
 void test_insert_and_lookup() {
     PerfectHash<int, int> table;
@@ -59,11 +60,143 @@ void test_heavy_insertions() {
     std::cout << "test_heavy_insertions passed\n";
 }
 
+void test_freeze() {
+    PerfectHash<int, int> table(1024);
+
+    for (int i = 0; i < 2000; ++i) {
+        table.insert(i, i * 10);
+    }
+    table.freeze();
+    assert(table.frozen());
+    assert(table.size() == 2000);
+
+    for (int i = 0; i < 2000; ++i) {
+        assert(table.lookup(i).value() == i * 10);
+    }
+    assert(!table.lookup(5000).has_value());
+
+    assert(table.update(7, 77));
+    assert(table.lookup(7).value() == 77);
+    assert(table.remove(8));
+    assert(!table.lookup(8).has_value());
+    assert(table.size() == 1999);
+
+    // Inserting into a taken slot thaws the table transparently.
+    for (int i = 2000; i < 3000; ++i) {
+        table.insert(i, i * 10);
+    }
+    assert(!table.frozen());
+    assert(table.size() == 2999);
+    for (int i = 2000; i < 3000; ++i) {
+        assert(table.lookup(i).value() == i * 10);
+    }
+    assert(table.lookup(7).value() == 77);
+
+    std::cout << "test_freeze passed\n";
+}
+
+// Every key hashes to the same value, so no seed can separate two keys.
+struct ConstHashKey {
+    int v;
+    bool operator==(const ConstHashKey &o) const { return v == o.v; }
+    bool operator!=(const ConstHashKey &o) const { return v != o.v; }
+};
+template <>
+struct std::hash<ConstHashKey> {
+    size_t operator()(const ConstHashKey &) const { return 42; }
+};
+
+void test_freeze_equal_hashes() {
+    PerfectHash<ConstHashKey, int> table(4);
+    for (int i = 0; i < 3; ++i) table.insert({i}, i);
+
+    bool threw = false;
+    try {
+        table.freeze();
+    } catch (const std::runtime_error &) {
+        threw = true;
+    }
+    assert(threw);
+    assert(!table.frozen());
+    for (int i = 0; i < 3; ++i) assert(table.lookup({i}).value() == i);
+    table.insert({3}, 3);
+    assert(table.lookup({3}).value() == 3);
+
+    PerfectHash<ConstHashKey, int> single(4);
+    single.insert({1}, 1);
+    single.freeze();
+    assert(single.frozen() && single.lookup({1}).value() == 1);
+
+    std::cout << "test_freeze_equal_hashes passed\n";
+}
+
+void test_growth() {
+    PerfectHash<int, int> table(4);
+
+    for (int i = 0; i < 40000; ++i) {
+        table.insert(i, i + 1);
+    }
+    assert(table.size() == 40000);
+    assert(table.capacity() >= 40000);
+    assert(table.secondarySlots() <= 8 * table.size());
+
+    for (int i = 0; i < 40000; ++i) {
+        assert(table.lookup(i).value() == i + 1);
+    }
+
+    std::cout << "test_growth passed\n";
+}
+
+void test_strided_growth() {
+    // std::hash is the identity for integers, so keys sharing their low
+    // bits must still spread once the top level grows.
+    for (uint64_t stride : {uint64_t(4096), uint64_t(65536)}) {
+        PerfectHash<uint64_t, int> table(4);
+        for (int i = 0; i < 40000; ++i) table.insert(i * stride, i);
+        assert(table.secondarySlots() <= 8 * table.size());
+        for (int i = 0; i < 40000; ++i)
+            assert(table.lookup(i * stride).value() == i);
+        table.freeze();
+        for (int i = 0; i < 40000; ++i)
+            assert(table.lookup(i * stride).value() == i);
+    }
+
+    std::cout << "test_strided_growth passed\n";
+}
+
+void test_bulk_build() {
+    std::vector<std::pair<int, int>> entries;
+    for (int i = 0; i < 300000; ++i) {
+        entries.emplace_back(i * 3, i);
+    }
+    entries.emplace_back(0, -1);  // duplicate key, last value wins
+
+    PerfectHash<int, int> table(entries, 4);
+    assert(table.size() == 300000);
+    assert(table.lookup(0).value() == -1);
+    for (int i = 1; i < 300000; ++i) {
+        assert(table.lookup(i * 3).value() == i);
+    }
+    assert(!table.lookup(1).has_value());
+
+    table.insert(1, 1);
+    assert(table.lookup(1).value() == 1);
+    table.freeze();
+    assert(table.lookup(299999 * 3).value() == 299999);
+
+    std::cout << "test_bulk_build passed\n";
+}
+
 int main() {
     test_insert_and_lookup();
     test_update();
     test_remove();
     test_heavy_insertions();
+    test_freeze();
+    test_freeze_equal_hashes();
+    test_growth();
+    test_strided_growth();
+    test_bulk_build();
 
     std::cout << "All tests passed for PerfectHash.\n";
     return 0;
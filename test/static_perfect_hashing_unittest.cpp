@@ -0,0 +1,73 @@
+// static_perfect_hashing_unittest.cpp
+#include "static_perfect_hashing.h"
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+void test_mphf_is_minimal_and_perfect() {
+    std::vector<uint64_t> keys;
+    for (uint64_t i = 0; i < 50000; ++i) keys.push_back(i * 7919 + 13);
+
+    MinimalPerfectHash<uint64_t> mphf(keys);
+    std::vector<bool> seen(keys.size(), false);
+    for (uint64_t k : keys) {
+        size_t idx = mphf(k);
+        assert(idx < keys.size());
+        assert(!seen[idx]);
+        seen[idx] = true;
+    }
+    assert(mphf.bitsPerKey() < 5.0);
+
+    std::cout << "test_mphf_is_minimal_and_perfect passed\n";
+}
+
+void test_lookup() {
+    std::vector<std::pair<int, int>> entries;
+    for (int i = 0; i < 10000; ++i) entries.emplace_back(i, i * 10);
+
+    StaticPerfectHash<int, int> table(entries);
+    assert(table.size() == entries.size());
+    for (int i = 0; i < 10000; ++i) assert(table.lookup(i).value() == i * 10);
+    for (int i = 10000; i < 20000; ++i) assert(!table.lookup(i).has_value());
+
+    std::cout << "test_lookup passed\n";
+}
+
+void test_string_keys_parallel() {
+    std::vector<std::pair<std::string, std::string>> entries;
+    for (int i = 0; i < 20000; ++i)
+        entries.emplace_back("key" + std::to_string(i), "val" + std::to_string(i));
+
+    StaticPerfectHash<std::string, std::string> table(entries, 2.0, 4);
+    for (const auto& [k, v] : entries) assert(table.lookup(k).value() == v);
+    assert(!table.lookup("missing").has_value());
+
+    std::cout << "test_string_keys_parallel passed\n";
+}
+
+void test_empty_and_duplicates() {
+    StaticPerfectHash<int, int> empty(std::vector<std::pair<int, int>>{});
+    assert(empty.size() == 0);
+    assert(!empty.lookup(1).has_value());
+
+    bool threw = false;
+    try {
+        StaticPerfectHash<int, int> dup({{1, 1}, {2, 2}, {1, 3}});
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "test_empty_and_duplicates passed\n";
+}
+
+int main() {
+    test_mphf_is_minimal_and_perfect();
+    test_lookup();
+    test_string_keys_parallel();
+    test_empty_and_duplicates();
+
+    std::cout << "All tests passed for StaticPerfectHash.\n";
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bplus_tree.h"
+
+void test_insert_search_remove() {
+    BPlusTree<int, int, 4> t;
+
+    for (int k : {10, 20, 5, 6, 12, 30, 7, 17}) t.insert(k, k * 10);
+    assert(t.size() == 8);
+
+    std::vector<int> keys;
+    for (auto [k, v] : t) {
+        assert(v == k * 10);
+        keys.push_back(k);
+    }
+    assert((keys == std::vector<int>{5, 6, 7, 10, 12, 17, 20, 30}));
+
+    assert(t.search(6).value() == 60);
+    assert(!t.search(15).has_value());
+
+    assert(t.remove(6));
+    assert(!t.contains(6));
+    assert(!t.remove(13));
+    assert(t.size() == 7);
+
+    t.insert(10, 11);
+    assert(t.search(10).value() == 11);
+    assert(t.size() == 7);
+
+    std::cout << "test_insert_search_remove passed\n";
+}
+
+void test_bounds_and_scan() {
+    BPlusTree<int, int> t;
+    for (int i = 0; i < 10000; i += 2) t.insert(i, -i);
+
+    assert(t.lower_bound(100).key() == 100);
+    assert(t.lower_bound(101).key() == 102);
+    assert(t.upper_bound(100).key() == 102);
+    assert(t.lower_bound(9999) == t.end());
+    assert(t.lower_bound(-5).key() == 0);
+
+    int expected = 1000;
+    size_t visited = t.scan(999, 2001, [&](int k, int v) {
+        assert(k == expected && v == -k);
+        expected += 2;
+    });
+    assert(visited == 501 && expected == 2002);
+    assert(t.scan(5000, 5000, [](int, int) { assert(false); }) == 0);
+
+    std::cout << "test_bounds_and_scan passed\n";
+}
+
+template <int Order>
+void check_against_map(uint64_t seed) {
+    BPlusTree<uint64_t, uint64_t, Order> t;
+    std::map<uint64_t, uint64_t> ref;
+    std::mt19937_64 rng(seed);
+
+    for (int i = 0; i < 200000; ++i) {
+        uint64_t k = rng() % 5000;
+        switch (rng() % 4) {
+            case 0:
+            case 1:
+                t.insert(k, i);
+                ref[k] = i;
+                break;
+            case 2:
+                assert(t.remove(k) == (ref.erase(k) == 1));
+                break;
+            default: {
+                auto it = ref.lower_bound(k);
+                auto bt = t.lower_bound(k);
+                assert((bt == t.end()) == (it == ref.end()));
+                if (it != ref.end())
+                    assert(bt.key() == it->first && bt.value() == it->second);
+            }
+        }
+    }
+    assert(t.size() == ref.size());
+
+    auto it = ref.begin();
+    for (auto [k, v] : t) {
+        assert(it != ref.end() && it->first == k && it->second == v);
+        ++it;
+    }
+    assert(it == ref.end());
+
+    // Draining the tree rebalances all the way down to an empty root.
+    for (auto& [k, v] : ref) assert(t.remove(k));
+    assert(t.size() == 0 && t.begin() == t.end());
+}
+
+void test_against_map() {
+    check_against_map<4>(1);
+    check_against_map<6>(2);
+    check_against_map<btreeDefaultOrder<uint64_t>()>(3);
+
+    std::cout << "test_against_map passed\n";
+}
+
+void test_string_keys_and_teardown() {
+    BPlusTree<std::string, std::string, 4> t;
+    for (int i = 0; i < 1000; ++i)
+        t.insert("key" + std::to_string(i), std::to_string(i));
+    for (int i = 0; i < 1000; i += 3) assert(t.remove("key" + std::to_string(i)));
+    assert(t.search("key500").value() == "500");
+    assert(!t.contains("key501"));
+
+    BPlusTree<std::string, std::string, 4> moved(std::move(t));
+    assert(t.size() == 0 && t.begin() == t.end());
+    assert(moved.size() == 666);
+
+    moved.clear();
+    assert(moved.size() == 0 && moved.bytes() == 0);
+    moved.insert("a", "b");
+    assert(moved.search("a").value() == "b");
+
+    std::cout << "test_string_keys_and_teardown passed\n";
+}
+
+int main() {
+    test_insert_search_remove();
+    test_bounds_and_scan();
+    test_against_map();
+    test_string_keys_and_teardown();
+
+    std::cout << "All BPlusTree tests passed successfully.\n";
+    return 0;
+}
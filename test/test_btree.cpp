@@ -1,40 +1,245 @@
+#include <algorithm>
+#include <cassert>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
 
 #include "btree.h"
 
+void test_insert_search_remove() {
+    BTree<int, int, 6> t;
+
+    for (int k : {10, 20, 5, 6, 12, 30, 7, 17}) t.insert(k, k * 10);
+    assert(t.size() == 8);
+
+    std::vector<int> keys;
+    t.traverse([&](int k, int v) {
+        assert(v == k * 10);
+        keys.push_back(k);
+    });
+    assert((keys == std::vector<int>{5, 6, 7, 10, 12, 17, 20, 30}));
+
+    assert(t.search(6).value() == 60);
+    assert(!t.search(15).has_value());
+
+    assert(t.remove(6));
+    assert(!t.contains(6));
+    assert(!t.remove(13));
+    assert(t.size() == 7);
+
+    t.insert(10, 11);
+    assert(t.search(10).value() == 11);
+    assert(t.size() == 7);
+
+    std::cout << "test_insert_search_remove passed\n";
+}
+
+void test_against_map() {
+    BTree<uint64_t, uint64_t> t;
+    std::map<uint64_t, uint64_t> ref;
+    std::mt19937_64 rng(7);
+
+    for (int i = 0; i < 200000; ++i) {
+        uint64_t k = rng() % 5000;
+        switch (rng() % 3) {
+            case 0:
+                t.insert(k, i);
+                ref[k] = i;
+                break;
+            case 1:
+                assert(t.remove(k) == (ref.erase(k) == 1));
+                break;
+            default: {
+                auto it = ref.find(k);
+                auto v = t.search(k);
+                assert(v.has_value() == (it != ref.end()));
+                if (v) assert(*v == it->second);
+            }
+        }
+    }
+    assert(t.size() == ref.size());
+
+    auto it = ref.begin();
+    t.traverse([&](uint64_t k, uint64_t v) {
+        assert(it != ref.end() && it->first == k && it->second == v);
+        ++it;
+    });
+    assert(it == ref.end());
+
+    std::cout << "test_against_map passed\n";
+}
+
+void test_string_keys_and_compare() {
+    BTree<std::string, int, 4, std::greater<std::string>> t;
+    for (int i = 0; i < 100; ++i) t.insert("key" + std::to_string(i), i);
+    for (int i = 0; i < 100; i += 2) assert(t.remove("key" + std::to_string(i)));
+
+    std::string prev;
+    t.traverse([&](const std::string& k, int v) {
+        assert(prev.empty() || k < prev);
+        assert(k == "key" + std::to_string(v) && v % 2 == 1);
+        prev = k;
+    });
+    assert(t.size() == 50);
+
+    // Four lines per node only when 64-bit keys are searched with SIMD.
+    static_assert(btreeDefaultOrder<uint64_t>() ==
+                  (btreeSimdCompiled(sizeof(uint64_t)) ? 32 : 16));
+    static_assert(btreeDefaultOrder<std::string>() == 4);
+
+    std::cout << "test_string_keys_and_compare passed\n";
+}
+
+// Compares nodeSearch on a sorted array against a plain scan, at every
+// length and around every key, including the extremes of the type.
+template <typename Key>
+void check_node_search() {
+    std::mt19937_64 rng(sizeof(Key) * 2 + std::is_signed_v<Key>);
+    std::vector<Key> keys = {std::numeric_limits<Key>::min(),
+                             std::numeric_limits<Key>::max()};
+    while (keys.size() < 40) keys.push_back(static_cast<Key>(rng()));
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    std::less<Key> less;
+    for (int n = 0; n <= static_cast<int>(keys.size()); ++n) {
+        for (Key k : keys) {
+            using U = std::make_unsigned_t<Key>;
+            for (Key probe : {k, Key(U(k) - 1), Key(U(k) + 1)}) {
+                int lo = 0, hi = 0;
+                while (lo < n && keys[lo] < probe) lo++;
+                while (hi < n && keys[hi] <= probe) hi++;
+                assert(nodeSearch(keys.data(), n, probe, less) == lo);
+                assert(nodeSearch<true>(keys.data(), n, probe, less) == hi);
+            }
+        }
+    }
+}
+
+void test_node_search() {
+    check_node_search<int8_t>();
+    check_node_search<uint8_t>();
+    check_node_search<int16_t>();
+    check_node_search<uint16_t>();
+    check_node_search<int32_t>();
+    check_node_search<uint32_t>();
+    check_node_search<int64_t>();
+    check_node_search<uint64_t>();
+
+    std::cout << "test_node_search passed\n";
+}
+
+template <int Order>
+void check_bulk_load(double fill) {
+    for (int n : {0, 1, 2, 3, 5, 7, 8, 9, 16, 17, 100, 255, 256, 257, 1000,
+                  4095, 20000}) {
+        std::vector<std::pair<int, int>> sorted;
+        for (int i = 0; i < n; ++i) sorted.push_back({2 * i, i});
+
+        BTree<int, int, Order> t;
+        t.insert(-1, -1);  // replaced by the load
+        t.bulkLoad(sorted.begin(), sorted.end(), fill);
+        assert(t.size() == static_cast<size_t>(n));
+        assert(!t.contains(-1));
+
+        // A full load reaches the least height any B-tree of this order can.
+        int h = 0;
+        for (uint64_t cap = 1; cap < uint64_t(n) + 1; cap *= Order) h++;
+        if (fill == 1.0) assert(t.height() == h);
+
+        int next = 0;
+        t.traverse([&](int k, int v) {
+            assert(k == 2 * next && v == next);
+            next++;
+        });
+        assert(next == n);
+
+        // The loaded tree must stay a valid B-tree under updates.
+        std::map<int, int> ref(sorted.begin(), sorted.end());
+        std::mt19937 rng(n);
+        for (int i = 0; i < 4 * n; ++i) {
+            int k = rng() % (2 * n + 2);
+            if (rng() % 2) {
+                assert(t.remove(k) == (ref.erase(k) == 1));
+            } else {
+                t.insert(k, i);
+                ref[k] = i;
+            }
+        }
+        for (auto& [k, v] : ref) assert(t.search(k).value() == v);
+        assert(t.size() == ref.size());
+    }
+}
+
+void test_bulk_load() {
+    check_bulk_load<4>(1.0);
+    check_bulk_load<4>(0.5);
+    check_bulk_load<6>(1.0);
+    check_bulk_load<6>(0.7);
+    check_bulk_load<btreeDefaultOrder<int>()>(1.0);
+    check_bulk_load<btreeDefaultOrder<int>()>(0.6);
+
+    std::vector<std::pair<int, int>> unsorted = {{1, 1}, {3, 3}, {2, 2}};
+    BTree<int, int> t;
+    bool threw = false;
+    try {
+        t.bulkLoad(unsorted.begin(), unsorted.end());
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    assert(threw);
+
+    std::cout << "test_bulk_load passed\n";
+}
+
+void test_clear_and_move() {
+    // Many small trees, as one per partition bucket would be.
+    std::vector<BTree<uint64_t, uint64_t>> trees(10000);
+    for (size_t i = 0; i < trees.size(); ++i)
+        for (uint64_t k = 0; k < 20; ++k) trees[i].insert(k, i);
+    for (size_t i = 0; i < trees.size(); ++i)
+        assert(trees[i].search(19).value() == i);
+
+    // Deleted nodes are reused, so churn does not grow the pool.
+    BTree<int, std::string, 4> t;
+    for (int i = 0; i < 1000; ++i) t.insert(i, std::to_string(i));
+    size_t bytes = t.bytes();
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 1000; ++i) assert(t.remove(i));
+        for (int i = 0; i < 1000; ++i) t.insert(i, std::to_string(i));
+    }
+    assert(t.bytes() == bytes);
+
+    BTree<int, std::string, 4> moved(std::move(t));
+    assert(t.size() == 0 && !t.contains(1));
+    assert(moved.size() == 1000 && moved.search(999).value() == "999");
+
+    moved.clear();
+    assert(moved.size() == 0 && moved.bytes() == 0);
+    assert(!moved.search(1).has_value());
+    moved.insert(1, "one");
+    assert(moved.search(1).value() == "one");
+
+    t = std::move(moved);
+    assert(t.size() == 1 && moved.size() == 0);
+
+    std::cout << "test_clear_and_move passed\n";
+}
+
 int main() {
-    BTree t;
-
-    t.insert({10, 10});
-    t.insert({20, 20});
-    t.insert({5, 5});
-    t.insert({6, 6});
-    t.insert({12, 12});
-    t.insert({30, 30});
-    t.insert({7, 7});
-    t.insert({17, 17});
-
-    cout << "Traversal of the constructed tree is: ";
-    t.traverse();
-    cout << endl;
-
-    int k = 6;
-    (t.search({k, k}) != nullptr) ? cout << k << " is found" << endl
-                             : cout << k << " is not found" << endl;
-
-    k = 15;
-    (t.search({k, k}) != nullptr) ? cout << k << " is found" << endl
-                             : cout << k << " is not found" << endl;
-
-    t.remove({6, 6});
-    cout << "Traversal of the tree after removing 6: ";
-    t.traverse();
-    cout << endl;
-
-    t.remove({13, 13});
-    cout << "Traversal of the tree after removing 13: ";
-    t.traverse();
-    cout << endl;
+    test_insert_search_remove();
+    test_against_map();
+    test_string_keys_and_compare();
+    test_node_search();
+    test_bulk_load();
+    test_clear_and_move();
 
+    std::cout << "All BTree tests passed successfully.\n";
     return 0;
-}
\ No newline at end of file
+}
@@ -1,6 +1,8 @@
 #include "indexed_partition_hash_with_btree.h"
 #include <cassert>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 void test_insert_and_lookup() {
     IndexedPartitionHashWithBTree<int, int> table;
@@ -73,12 +75,88 @@ void test_collisions() {
     std::cout << "test_collisions passed\n";
 }
 
+void test_delete_churn() {
+    IndexedPartitionHashWithBTree<int, int> table(100000);
+
+    // Repeated insert/remove cycles leave tombstones in the query mappers,
+    // which must be reclaimed without losing live keys.
+    for (int round = 0; round < 60; ++round) {
+        for (int i = 0; i < 5000; ++i) table.insert(round * 5000 + i, i);
+        for (int i = 0; i < 5000; ++i) {
+            if (i % 7 != 0) assert(table.remove(round * 5000 + i));
+        }
+    }
+    assert(table.size() == 60 * 715);
+
+    for (int round = 0; round < 60; ++round) {
+        for (int i = 0; i < 5000; ++i) {
+            auto v = table.lookup(round * 5000 + i);
+            assert(v.has_value() == (i % 7 == 0));
+            if (v.has_value()) assert(v.value() == i);
+        }
+    }
+
+    std::cout << "test_delete_churn passed\n";
+}
+
+void test_parallel_rehash() {
+    IndexedPartitionHashWithBTree<int, int> table(1 << 10);
+    table.set_rehash_threads(4);
+
+    const int N = 400000;  // grows through several parallel rehashes
+    for (int i = 0; i < N; ++i) table.insert(i, i + 1);
+    assert(table.size() == N);
+
+    for (int i = 0; i < N; ++i) assert(table.lookup(i).value() == i + 1);
+    for (int i = 0; i < N; i += 2) assert(table.remove(i));
+    table.rehash();
+    assert(table.size() == N / 2);
+    for (int i = 0; i < N; ++i)
+        assert(table.lookup(i).has_value() == (i % 2 == 1));
+
+    std::cout << "test_parallel_rehash passed\n";
+}
+
+void test_concurrent() {
+    const int THREADS = 4, PER_THREAD = 20000;
+    IndexedPartitionHashWithBTree<int, int, true> table(THREADS * PER_THREAD);
+
+    // Each thread owns a disjoint key range but shares buckets with others.
+    std::vector<std::thread> workers;
+    for (int t = 0; t < THREADS; ++t) {
+        workers.emplace_back([&table, t] {
+            for (int i = t; i < THREADS * PER_THREAD; i += THREADS)
+                table.insert(i, i);
+            for (int i = t; i < THREADS * PER_THREAD; i += THREADS) {
+                assert(table.lookup(i).value() == i);
+                assert(table.update(i, -i));
+            }
+            for (int i = t; i < THREADS * PER_THREAD; i += 2 * THREADS)
+                assert(table.remove(i));
+        });
+    }
+    for (auto& w : workers) w.join();
+
+    assert(table.size() == THREADS * PER_THREAD / 2);
+    for (int i = 0; i < THREADS * PER_THREAD; ++i) {
+        bool kept = (i % (2 * THREADS)) >= THREADS;
+        auto v = table.lookup(i);
+        assert(v.has_value() == kept);
+        if (kept) assert(v.value() == -i);
+    }
+
+    std::cout << "test_concurrent passed\n";
+}
+
 int main() {
     test_insert_and_lookup();
     test_delete();
     test_update();
     test_resize();
     test_collisions();
+    test_delete_churn();
+    test_parallel_rehash();
+    test_concurrent();
 
     std::cout << "All IndexedPartitionHashWithBTree tests passed successfully.\n";
     return 0;